@@ -2,6 +2,7 @@
 
 in float vertDiffuseLight;
 in float vertAmbientLight;
+in vec3 vertColor;
 
 out vec4 fragColor;
 
@@ -10,5 +11,5 @@ void main()
     float brightness =
         0.5 * vertAmbientLight
         + 0.5 * vertDiffuseLight;
-    fragColor = vec4(brightness * vec3(1.0), 1.0);
+    fragColor = vec4(brightness * vertColor, 1.0);
 }
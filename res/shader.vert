@@ -1,20 +1,44 @@
 #version 330 core
 
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in float brightness;
+// Packed as described in src/vertex.hpp.
+layout(location = 0) in uint vertex;
 
 out float vertDiffuseLight;
 out float vertAmbientLight;
+out vec3 vertColor;
 
 uniform mat4 modelToClip;
 
 const vec3 dirToLight = normalize(vec3(0.2, 1.0, 0.0));
 
+const vec3 normals[6] = vec3[6](
+    vec3(-1.0, 0.0, 0.0),
+    vec3(1.0, 0.0, 0.0),
+    vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, -1.0),
+    vec3(0.0, 0.0, 1.0));
+
+// Indexed by the Voxel values in src/voxel.hpp.
+const vec3 materialColors[4] = vec3[4](
+    vec3(1.0, 0.0, 1.0),
+    vec3(1.0, 1.0, 1.0),
+    vec3(0.55, 0.4, 0.25),
+    vec3(0.35, 0.7, 0.25));
+
 void main()
 {
+    vec3 position = vec3(
+        vertex & 0x7Fu,
+        (vertex >> 7) & 0x7Fu,
+        (vertex >> 14) & 0x7Fu);
+    vec3 normal = normals[(vertex >> 21) & 0x7u];
+    float brightness = float(((vertex >> 24) & 0x7u) << 5) / 255.0;
+    uint material = min((vertex >> 27) & 0x1Fu, 3u);
+
     vertDiffuseLight = max(0.0, dot(normal, dirToLight));
     vertAmbientLight = brightness;
+    vertColor = materialColors[material];
 
     gl_Position = modelToClip * vec4(position, 1.0);
 }
@@ -0,0 +1,724 @@
+// Benchmarks of the chunk pipeline that run without a display or a GPU,
+// built and run by `make bench`. Prints one JSON object per benchmark and
+// line, so that results can be compared from one commit to the next.
+
+#define GLM_FORCE_RADIANS
+
+#include "build_scheduler.hpp"
+#include "camera.hpp"
+#include "chunk.hpp"
+#include "chunk_neighborhood.hpp"
+#include "chunk_volume_repository.hpp"
+#include "column_volume.hpp"
+#include "heightmap.hpp"
+#include "log.hpp"
+#include "mesh_builder.hpp"
+#include "mesh_data.hpp"
+#include "noise_terrain.hpp"
+#include "palette_volume.hpp"
+#include "sectioned_volume.hpp"
+#include "solid_masks.hpp"
+#include "vertex.hpp"
+#include "visible_chunks.hpp"
+#include "volume.hpp"
+#include "volumegen.hpp"
+#include "voxel.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Every benchmark runs over the same square of chunks, a few times over,
+// and reports its fastest round.
+constexpr int grid_size = 8;
+constexpr size_t chunk_count = grid_size * grid_size;
+constexpr size_t rounds = 5;
+
+constexpr size_t volume_byte_budget = 64 << 20;
+
+// Half of what the log buffers, and far more.
+constexpr size_t log_burst_calls = Log::buffered_entries / 2;
+constexpr size_t log_sustained_calls = 1 << 20;
+
+// Explosions centered on the corner of each chunk, at the average height
+// of the terrain, which empty every voxel within the radius.
+constexpr int explosion_radius = 10;
+constexpr int explosion_y = 26;
+
+constexpr int culling_view_radius = 8;
+constexpr int culling_directions = 360;
+
+constexpr int scheduler_view_radius = 12;
+constexpr size_t scheduler_frames = 1000;
+constexpr size_t scheduler_builds_in_flight = 8;
+constexpr size_t scheduler_builds_per_frame = 4;
+
+// What a benchmark built for a chunk, if anything.
+struct ChunkResult
+{
+    size_t vertices;
+    // Of the volume or mesh built or read.
+    size_t bytes;
+};
+
+std::atomic<size_t> allocation_count(0);
+// Benchmarks store part of their results here, so that none of the work
+// can be optimized away.
+volatile int result_sink;
+
+void* operator new(size_t size)
+{
+    ++allocation_count;
+    if (void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Not inlined, so that the compiler does not take the free() for the
+// release of memory that did not come from malloc().
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+ChunkId grid_chunk(size_t chunk_index);
+Heightmap sample_heightmap_per_point(
+        glm::ivec3 begin_coord, glm::ivec3 end_coord, int border_size);
+template <typename V>
+size_t count_solid(const V&);
+size_t count_visible_faces(const Volume<Voxel>&);
+size_t count_visible_faces(const SolidMasks&);
+ChunkResult mesh_result(const MeshData&);
+ChunkVolumeRepository::VolumeSampler terrain_volume_sampler();
+void sample_grid_and_neighbors(ChunkVolumeRepository&);
+std::unordered_map<ChunkId, Chunks::SectionSet> explode(
+        ChunkVolumeRepository&, glm::ivec3 center);
+
+template <typename F>
+void run(const char* name, F f);
+void run_log_benchmark(
+        const char* name, size_t thread_count, size_t calls);
+void run_culling_benchmark();
+void run_scheduler_benchmark();
+
+int main()
+{
+    std::vector<Heightmap> heightmaps;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        heightmaps.push_back(sample_heightmap(
+                    Chunks::begin_coord(grid_chunk(i)),
+                    Chunks::end_coord(grid_chunk(i)),
+                    1));
+    }
+    const int y_size = Chunks::y_end - Chunks::y_begin;
+
+    run("sample_heightmap", [&](size_t i, size_t) {
+        const ChunkId chunk_id = grid_chunk(i);
+        const Heightmap heightmap = sample_heightmap(
+                Chunks::begin_coord(chunk_id), Chunks::end_coord(chunk_id), 1);
+        result_sink = heightmap.at(0, 0);
+        return ChunkResult{};
+    });
+
+    run("sample_heightmap_per_point", [&](size_t i, size_t) {
+        const ChunkId chunk_id = grid_chunk(i);
+        const Heightmap heightmap = sample_heightmap_per_point(
+                Chunks::begin_coord(chunk_id), Chunks::end_coord(chunk_id), 1);
+        result_sink = heightmap.at(0, 0);
+        return ChunkResult{};
+    });
+
+    size_t mismatched_samples = 0;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        const ChunkId chunk_id = grid_chunk(i);
+        const Heightmap reference = sample_heightmap_per_point(
+                Chunks::begin_coord(chunk_id), Chunks::end_coord(chunk_id), 1);
+        for (size_t z = 0; z < reference.z_size(); ++z) {
+            for (size_t x = 0; x < reference.x_size(); ++x) {
+                mismatched_samples +=
+                    reference.at(x, z) != heightmaps[i].at(x, z);
+            }
+        }
+    }
+    std::printf(
+            "{\"benchmark\": \"sample_heightmap_against_per_point\", "
+            "\"chunks\": %zu, \"mismatched_samples\": %zu}\n",
+            chunk_count, mismatched_samples);
+
+    run("volume_from_heightmap", [&](size_t i, size_t) {
+        const Volume<Voxel> volume =
+            volume_from_heightmap(heightmaps[i], y_size, 1);
+        result_sink = int(volume.at(0, 0, 0));
+        return ChunkResult{0, volume.byte_size()};
+    });
+
+    NoiseTerrain::Settings cave_settings;
+    cave_settings.caves = true;
+    const NoiseTerrain terrain(NoiseTerrain::Settings{});
+    const NoiseTerrain cave_terrain(cave_settings);
+
+    run("noise_terrain_heightmap", [&](size_t i, size_t) {
+        const ChunkId chunk_id = grid_chunk(i);
+        const Heightmap heightmap = terrain.heightmap(
+                Chunks::begin_coord(chunk_id), Chunks::end_coord(chunk_id), 1);
+        result_sink = heightmap.at(0, 0);
+        return ChunkResult{};
+    });
+
+    run("noise_terrain_volume_with_caves", [&](size_t i, size_t) {
+        const ChunkId chunk_id = grid_chunk(i);
+        const Volume<Voxel> volume = cave_terrain.volume(
+                Chunks::begin_coord(chunk_id), Chunks::end_coord(chunk_id), 0);
+        result_sink = int(volume.at(0, 0, 0));
+        return ChunkResult{0, volume.byte_size()};
+    });
+
+    // A volume stored densely, palette compressed as a whole, and palette
+    // compressed by section as the repository stores it: how long each
+    // takes to build from the dense one, how many bytes it takes, and how
+    // long reading every voxel through at() takes.
+    std::vector<Volume<Voxel>> dense_volumes;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        dense_volumes.push_back(terrain.volume(
+                    Chunks::begin_coord(grid_chunk(i)),
+                    Chunks::end_coord(grid_chunk(i)),
+                    0));
+    }
+    std::vector<PaletteVolume<Voxel>> palette_volumes;
+    std::vector<SectionedVolume> sectioned_volumes;
+    for (const Volume<Voxel>& volume : dense_volumes) {
+        palette_volumes.emplace_back(volume);
+        sectioned_volumes.emplace_back(volume, 0, Chunks::section_height);
+    }
+
+    run("palette_volume_from_volume", [&](size_t i, size_t) {
+        const PaletteVolume<Voxel> volume(dense_volumes[i]);
+        return ChunkResult{0, volume.byte_size()};
+    });
+    run("sectioned_volume_from_volume", [&](size_t i, size_t) {
+        const SectionedVolume volume(
+                dense_volumes[i], 0, Chunks::section_height);
+        return ChunkResult{0, volume.byte_size()};
+    });
+    run("dense_volume_read", [&](size_t i, size_t) {
+        result_sink = int(count_solid(dense_volumes[i]));
+        return ChunkResult{0, dense_volumes[i].byte_size()};
+    });
+    run("palette_volume_read", [&](size_t i, size_t) {
+        result_sink = int(count_solid(palette_volumes[i]));
+        return ChunkResult{0, palette_volumes[i].byte_size()};
+    });
+    run("sectioned_volume_read", [&](size_t i, size_t) {
+        result_sink = int(count_solid(sectioned_volumes[i]));
+        return ChunkResult{0, sectioned_volumes[i].byte_size()};
+    });
+    dense_volumes.clear();
+    palette_volumes.clear();
+    sectioned_volumes.clear();
+
+    // Finding the visible faces of a padded chunk, which every mesh build
+    // starts with: by looking up the six neighbors of every voxel, or by
+    // loading the solid masks and shifting whole rows of them. The last
+    // case leaves out loading them.
+    std::vector<Volume<Voxel>> padded_volumes;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        padded_volumes.push_back(terrain.volume(
+                    Chunks::begin_coord(grid_chunk(i)),
+                    Chunks::end_coord(grid_chunk(i)),
+                    1));
+    }
+    run("face_culling_per_voxel", [&](size_t i, size_t) {
+        result_sink = int(count_visible_faces(padded_volumes[i]));
+        return ChunkResult{};
+    });
+    std::vector<SolidMasks> solid_masks(chunk_count);
+    run("face_culling_solid_masks", [&](size_t i, size_t) {
+        solid_masks[i].load(padded_volumes[i]);
+        result_sink = int(count_visible_faces(solid_masks[i]));
+        return ChunkResult{};
+    });
+    run("face_culling_loaded_solid_masks", [&](size_t i, size_t) {
+        result_sink = int(count_visible_faces(solid_masks[i]));
+        return ChunkResult{};
+    });
+    padded_volumes.clear();
+    solid_masks.clear();
+
+    // Every round samples into a repository of its own.
+    std::vector<std::unique_ptr<ChunkVolumeRepository>> cold_repositories;
+    for (size_t round = 0; round < rounds; ++round) {
+        cold_repositories.emplace_back(new ChunkVolumeRepository(
+                    terrain_volume_sampler(), volume_byte_budget));
+    }
+    run("volume_repository_miss", [&](size_t i, size_t round) {
+        ChunkVolumeRepository& cold_repository = *cold_repositories[round];
+        const size_t bytes_before = cold_repository.stats().bytes_resident;
+        cold_repository.with(grid_chunk(i), [](const SectionedVolume&) {});
+        return ChunkResult{
+            0, cold_repository.stats().bytes_resident - bytes_before};
+    });
+    cold_repositories.clear();
+
+    // Holds the neighbors of the grid as well, so that meshing never
+    // samples.
+    ChunkVolumeRepository repository(
+            terrain_volume_sampler(), volume_byte_budget);
+    sample_grid_and_neighbors(repository);
+    run("volume_repository_hit", [&](size_t i, size_t) {
+        repository.with(grid_chunk(i), [](const SectionedVolume&) {});
+        return ChunkResult{};
+    });
+
+    // What edited chunks and cave terrain start meshing with.
+    SolidMasks neighborhood_masks;
+    run("solid_masks_from_neighborhood", [&](size_t i, size_t) {
+        repository.with_neighborhood(grid_chunk(i),
+                [&](const ChunkNeighborhood& neighborhood) {
+            neighborhood_masks.load(neighborhood);
+        });
+        result_sink = int(neighborhood_masks.section_uniformity(0));
+        return ChunkResult{};
+    });
+
+    MeshBuilder per_face_builder(MeshBuilder::Mode::per_face);
+    run("mesh_builder_build_per_face", [&](size_t i, size_t) {
+        ChunkResult result {};
+        repository.with_neighborhood(grid_chunk(i),
+                [&](const ChunkNeighborhood& neighborhood) {
+            result = mesh_result(per_face_builder.build(neighborhood));
+        });
+        return result;
+    });
+
+    MeshBuilder greedy_builder(MeshBuilder::Mode::greedy);
+    run("mesh_builder_build_greedy", [&](size_t i, size_t) {
+        ChunkResult result {};
+        repository.with_neighborhood(grid_chunk(i),
+                [&](const ChunkNeighborhood& neighborhood) {
+            result = mesh_result(greedy_builder.build(neighborhood));
+        });
+        return result;
+    });
+
+    // From sampling to mesh, for the same chunks of the same terrain: its
+    // volume with the border meshing needs, or only its heightmap.
+    run("noise_terrain_volume_to_greedy_mesh", [&](size_t i, size_t) {
+        const ChunkId chunk_id = grid_chunk(i);
+        const Volume<Voxel> volume = terrain.volume(
+                Chunks::begin_coord(chunk_id), Chunks::end_coord(chunk_id), 1);
+        return mesh_result(greedy_builder.build(volume));
+    });
+    run("noise_terrain_heightmap_to_greedy_mesh", [&](size_t i, size_t) {
+        const ChunkId chunk_id = grid_chunk(i);
+        const Heightmap heightmap = terrain.heightmap(
+                Chunks::begin_coord(chunk_id), Chunks::end_coord(chunk_id), 1);
+        return mesh_result(greedy_builder.build(heightmap, y_size, 1));
+    });
+
+    // Greedy meshing the same padded terrain, stored densely or as runs
+    // along its columns. The bytes are those of the volume meshed.
+    std::vector<Volume<Voxel>> dense_terrain_volumes;
+    std::vector<ColumnVolume> column_terrain_volumes;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        const Heightmap heightmap = terrain.heightmap(
+                Chunks::begin_coord(grid_chunk(i)),
+                Chunks::end_coord(grid_chunk(i)),
+                1);
+        dense_terrain_volumes.push_back(
+                volume_from_heightmap(heightmap, y_size, 1));
+        column_terrain_volumes.push_back(
+                column_volume_from_heightmap(heightmap, y_size, 1));
+    }
+    run("dense_volume_to_greedy_mesh", [&](size_t i, size_t) {
+        const MeshData mesh = greedy_builder.build(dense_terrain_volumes[i]);
+        return ChunkResult{
+            mesh.vertices.size(), dense_terrain_volumes[i].byte_size()};
+    });
+    run("column_volume_to_greedy_mesh", [&](size_t i, size_t) {
+        const MeshData mesh = greedy_builder.build(column_terrain_volumes[i]);
+        return ChunkResult{
+            mesh.vertices.size(), column_terrain_volumes[i].byte_size()};
+    });
+    dense_terrain_volumes.clear();
+    column_terrain_volumes.clear();
+
+    // Every round explodes the same spots of a repository of its own, with
+    // all volumes sampled beforehand.
+    std::vector<std::unique_ptr<ChunkVolumeRepository>> edit_repositories;
+    for (size_t round = 0; round < rounds; ++round) {
+        edit_repositories.emplace_back(new ChunkVolumeRepository(
+                    terrain_volume_sampler(), volume_byte_budget));
+        sample_grid_and_neighbors(*edit_repositories.back());
+    }
+    // The sections each explosion leaves to be rebuilt, by chunk.
+    std::vector<std::unordered_map<ChunkId, Chunks::SectionSet>>
+        dirty_sections(chunk_count);
+    run("edit_explosion", [&](size_t i, size_t round) {
+        dirty_sections[i] = explode(
+                *edit_repositories[round],
+                Chunks::begin_coord(grid_chunk(i)) + glm::ivec3(
+                    0, explosion_y, 0));
+        return ChunkResult{};
+    });
+    edit_repositories.resize(1);
+
+    // Only the sections an explosion touched, in the chunks it touched, as
+    // ChunkMeshRepository rebuilds them.
+    size_t remeshed_chunks = 0;
+    size_t remeshed_sections = 0;
+    for (const auto& dirty : dirty_sections) {
+        remeshed_chunks += dirty.size();
+        for (const auto& chunk_sections : dirty) {
+            for (int i = 0; i < Chunks::section_count; ++i) {
+                remeshed_sections += chunk_sections.second >> i & 1;
+            }
+        }
+    }
+    std::printf(
+            "{\"benchmark\": \"edit_explosion_extent\", "
+            "\"radius\": %d, \"chunks_per_explosion\": %.2f, "
+            "\"sections_per_explosion\": %.2f}\n",
+            explosion_radius, remeshed_chunks / double(chunk_count),
+            remeshed_sections / double(chunk_count));
+
+    run("edit_explosion_remesh", [&](size_t i, size_t) {
+        size_t vertices = 0;
+        for (const auto& dirty : dirty_sections[i]) {
+            edit_repositories.front()->with_neighborhood(dirty.first,
+                    [&](const ChunkNeighborhood& neighborhood) {
+                greedy_builder.load(neighborhood);
+                for (size_t j = 0; j < greedy_builder.section_count(); ++j) {
+                    if (dirty.second >> j & 1) {
+                        vertices += greedy_builder.build_section(j)
+                            .vertices.size();
+                    }
+                }
+            });
+        }
+        return ChunkResult{vertices, 0};
+    });
+    edit_repositories.clear();
+
+    run_culling_benchmark();
+    run_scheduler_benchmark();
+    for (const size_t threads : {1, 4}) {
+        run_log_benchmark("log_info_burst", threads, log_burst_calls);
+        run_log_benchmark("log_info_sustained", threads, log_sustained_calls);
+    }
+}
+
+ChunkId grid_chunk(const size_t chunk_index)
+{
+    return { int(chunk_index % grid_size), int(chunk_index / grid_size) };
+}
+
+// What sample_heightmap computed before it was made separable, sin(x) and
+// cos(z) for every sample, as the reference for its heights and speed.
+Heightmap sample_heightmap_per_point(
+        const glm::ivec3 begin_coord,
+        const glm::ivec3 end_coord,
+        const int border_size)
+{
+    const size_t x_size = end_coord.x - begin_coord.x;
+    const size_t y_size = end_coord.y - begin_coord.y;
+    const size_t z_size = end_coord.z - begin_coord.z;
+
+    Heightmap heightmap(x_size + 2 * border_size, z_size + 2 * border_size);
+    for (size_t vz = 0; vz < heightmap.z_size(); ++vz) {
+        for (size_t vx = 0; vx < heightmap.x_size(); ++vx) {
+            const double x =
+                (begin_coord.x + (int)vx - border_size) / (double) x_size;
+            const double z =
+                (begin_coord.z + (int)vz - border_size) / (double) z_size;
+
+            const double y = 0.5 * (sin(x) * cos(z) + 1);
+            heightmap.at(vx, vz) = y_size * y;
+        }
+    }
+    return heightmap;
+}
+
+// Reads every voxel, in storage order.
+template <typename V>
+size_t count_solid(const V& volume)
+{
+    size_t solid = 0;
+    for (size_t z = 0; z < volume.size_z(); ++z) {
+        for (size_t y = 0; y < volume.size_y(); ++y) {
+            for (size_t x = 0; x < volume.size_x(); ++x) {
+                solid += volume.at(x, y, z) != Voxel::empty;
+            }
+        }
+    }
+    return solid;
+}
+
+// Of the interior voxels.
+size_t count_visible_faces(const Volume<Voxel>& volume)
+{
+    size_t faces = 0;
+    for (size_t z = 1; z < volume.size_z() - 1; ++z) {
+        for (size_t y = 1; y < volume.size_y() - 1; ++y) {
+            for (size_t x = 1; x < volume.size_x() - 1; ++x) {
+                if (volume.at(x, y, z) == Voxel::empty) {
+                    continue;
+                }
+                for (const glm::ivec3& normal : Vertices::normals) {
+                    faces += volume.at(glm::ivec3(x, y, z) + normal)
+                        == Voxel::empty;
+                }
+            }
+        }
+    }
+    return faces;
+}
+
+size_t count_visible_faces(const SolidMasks& solid_masks)
+{
+    size_t faces = 0;
+    for (size_t z = 1; z < solid_masks.size_z() - 1; ++z) {
+        for (size_t y = 1; y < solid_masks.size_y() - 1; ++y) {
+            uint64_t row_faces[6];
+            solid_masks.visible_faces(y, z, row_faces);
+            for (const uint64_t direction_faces : row_faces) {
+                faces += __builtin_popcountll(direction_faces);
+            }
+        }
+    }
+    return faces;
+}
+
+ChunkResult mesh_result(const MeshData& mesh)
+{
+    return ChunkResult{
+        mesh.vertices.size(),
+        mesh.vertices.size() * sizeof(PackedVertex)
+            + mesh.short_indices.size() * sizeof(uint16_t)
+            + mesh.indices.size() * sizeof(uint32_t)};
+}
+
+ChunkVolumeRepository::VolumeSampler terrain_volume_sampler()
+{
+    const NoiseTerrain terrain(NoiseTerrain::Settings{});
+    return [terrain](glm::ivec3 begin, glm::ivec3 end, int border) {
+        return terrain.volume(begin, end, border);
+    };
+}
+
+// Along with the chunks around the grid, so that meshing the grid never
+// samples.
+void sample_grid_and_neighbors(ChunkVolumeRepository& repository)
+{
+    for (int z = -1; z <= grid_size; ++z) {
+        for (int x = -1; x <= grid_size; ++x) {
+            repository.with({x, z}, [](const SectionedVolume&) {});
+        }
+    }
+}
+
+// Empties the voxels within explosion_radius of the center, returning the
+// sections to rebuild as ChunkMeshRepository::apply_edits collects them.
+std::unordered_map<ChunkId, Chunks::SectionSet> explode(
+        ChunkVolumeRepository& repository, const glm::ivec3 center)
+{
+    std::unordered_map<ChunkId, Chunks::SectionSet> dirty_sections;
+    const int r = explosion_radius;
+    for (int dz = -r; dz <= r; ++dz) {
+        for (int dy = -r; dy <= r; ++dy) {
+            for (int dx = -r; dx <= r; ++dx) {
+                const glm::ivec3 pos = center + glm::ivec3(dx, dy, dz);
+                if (dx * dx + dy * dy + dz * dz > r * r
+                        || pos.y < Chunks::y_begin || pos.y >= Chunks::y_end) {
+                    continue;
+                }
+                const Chunks::SectionSet sections =
+                    Chunks::sections_around(pos.y);
+                for (const ChunkId chunk_id
+                        : repository.set_voxel(pos, Voxel::empty)) {
+                    dirty_sections[chunk_id] |= sections;
+                }
+            }
+        }
+    }
+    return dirty_sections;
+}
+
+// Calls f(chunk_index, round) for every chunk of the grid in every round.
+// f returns a ChunkResult.
+template <typename F>
+void run(const char* name, F f)
+{
+    using Clock = std::chrono::steady_clock;
+
+    double best_ns = 0;
+    size_t vertices = 0;
+    size_t bytes = 0;
+    size_t allocations = 0;
+    for (size_t round = 0; round < rounds; ++round) {
+        const size_t allocations_before = allocation_count;
+        const auto begin = Clock::now();
+        for (size_t i = 0; i < chunk_count; ++i) {
+            const ChunkResult result = f(i, round);
+            vertices += result.vertices;
+            bytes += result.bytes;
+        }
+        const double ns =
+            std::chrono::duration<double, std::nano>(Clock::now() - begin)
+            .count();
+        allocations += allocation_count - allocations_before;
+
+        if (round == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+
+    // Every benchmark runs on one thread, so this is per core.
+    const double chunk_voxels = double(Chunks::x_size) * Chunks::z_size
+        * (Chunks::y_end - Chunks::y_begin);
+    const double runs = rounds * chunk_count;
+    std::printf(
+            "{\"benchmark\": \"%s\", \"chunks\": %zu, "
+            "\"ns_per_chunk\": %.0f, \"voxels_per_second\": %.3g, "
+            "\"vertices_per_chunk\": %.1f, "
+            "\"bytes_per_chunk\": %.0f, \"allocations_per_chunk\": %.1f}\n",
+            name, chunk_count, best_ns / chunk_count,
+            chunk_voxels * chunk_count / best_ns * 1e9, vertices / runs,
+            bytes / runs, allocations / runs);
+}
+
+// INFO messages of a typical length from several threads at once, written
+// to /dev/null. A burst fits into the buffer, so none of it is dropped and
+// its calls per second are what logging costs the caller. A sustained run
+// overflows it: its calls per second are mostly those of dropping, and
+// only the delivered messages per second, up to the output being flushed,
+// compare with a logger that writes every message.
+void run_log_benchmark(
+        const char* name, const size_t thread_count, const size_t calls)
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::ofstream null_output("/dev/null");
+    Log::set_output(null_output);
+    const size_t dropped_before = Log::dropped();
+
+    const auto begin = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([t, thread_count, calls]() {
+            for (size_t i = t; i < calls; i += thread_count) {
+                Log::info("Built chunk " << i << " on thread " << t
+                        << " in " << 1.25 << " ms");
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const auto logged = Clock::now();
+    Log::flush();
+    const auto flushed = Clock::now();
+    Log::set_output(std::cout);
+
+    const auto seconds = [](Clock::duration d) {
+        return std::chrono::duration<double>(d).count();
+    };
+    const size_t dropped = Log::dropped() - dropped_before;
+    std::printf(
+            "{\"benchmark\": \"%s\", \"threads\": %zu, "
+            "\"calls\": %zu, \"calls_per_second\": %.0f, "
+            "\"delivered_per_second\": %.0f, \"dropped\": %zu}\n",
+            name, thread_count, calls, calls / seconds(logged - begin),
+            (calls - dropped) / seconds(flushed - begin), dropped);
+}
+
+// Turns the camera once around, a degree per update, looking slightly
+// down as a player would.
+void run_culling_benchmark()
+{
+    using Clock = std::chrono::steady_clock;
+
+    Camera camera(16 / 9.f);
+    camera.set_position({32.f, 80.f, 32.f});
+    VisibleChunks visible_chunks(culling_view_radius);
+
+    size_t visible = 0;
+    size_t in_range = 0;
+    const auto begin = Clock::now();
+    for (int i = 0; i < culling_directions; ++i) {
+        camera.look(glm::radians(float(i)), glm::radians(-20.f));
+        visible_chunks.update(camera);
+        visible += visible_chunks.chunks().size();
+        in_range += visible_chunks.in_range_count();
+    }
+    const double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - begin)
+        .count();
+
+    std::printf(
+            "{\"benchmark\": \"visible_chunks_update\", "
+            "\"chunks_in_range\": %zu, \"ns_per_update\": %.0f, "
+            "\"visible_per_update\": %.1f, \"culled_fraction\": %.3f}\n",
+            in_range / culling_directions, ns / culling_directions,
+            visible / double(culling_directions),
+            1 - visible / double(in_range));
+}
+
+// Every chunk in range is asked for in every frame, as when the view radius
+// has just grown, while the camera turns.
+void run_scheduler_benchmark()
+{
+    using Clock = std::chrono::steady_clock;
+
+    const int radius = scheduler_view_radius;
+    std::vector<ChunkId> in_range;
+    for (int z = -radius; z <= radius; ++z) {
+        for (int x = -radius; x <= radius; ++x) {
+            if (x * x + z * z <= radius * radius) {
+                in_range.push_back({x, z});
+            }
+        }
+    }
+
+    BuildScheduler scheduler(
+            scheduler_builds_in_flight, scheduler_builds_per_frame);
+    size_t started = 0;
+    const auto begin = Clock::now();
+    for (size_t frame = 0; frame < scheduler_frames; ++frame) {
+        const float angle = glm::radians(float(frame % 360));
+        scheduler.set_viewpoint(
+                {32.f, 80.f, 32.f},
+                {std::sin(angle), 0.f, -std::cos(angle)});
+        for (const ChunkId chunk_id : in_range) {
+            scheduler.request(chunk_id);
+        }
+        // As if half of the builds in flight finished every frame.
+        started += scheduler.take(scheduler_builds_in_flight / 2).size();
+    }
+    const double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - begin)
+        .count();
+
+    std::printf(
+            "{\"benchmark\": \"build_scheduler_frame\", "
+            "\"requests_per_frame\": %zu, \"ns_per_frame\": %.0f, "
+            "\"builds_per_frame\": %.1f}\n",
+            in_range.size(), ns / scheduler_frames,
+            started / double(scheduler_frames));
+}
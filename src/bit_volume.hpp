@@ -0,0 +1,115 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include "volume.hpp"
+#include "voxel.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// A volume of empty and solid voxels taking one bit per voxel. Every (y, z)
+// row starts at a new 64-bit word, with bit i of word w standing for the
+// voxel at x = 64 * w + i, so meshing kernels can take whole rows at once.
+class BitVolume
+{
+public:
+    static constexpr size_t word_bits = 64;
+
+    BitVolume(size_t x, size_t y, size_t z)
+        : s_x(x)
+        , s_y(y)
+        , s_z(z)
+        , words_per_row((x + word_bits - 1) / word_bits)
+        , words(words_per_row * y * z, 0)
+    {}
+
+    explicit BitVolume(const Volume<Voxel>&);
+
+    size_t size_x() const { return s_x; }
+    size_t size_y() const { return s_y; }
+    size_t size_z() const { return s_z; }
+    size_t byte_size() const { return words.size() * sizeof(uint64_t); }
+
+    Voxel at(size_t x, size_t y, size_t z) const;
+    Voxel at(glm::ivec3 v) const { return at(v.x, v.y, v.z); }
+    void set(size_t x, size_t y, size_t z, Voxel);
+
+    // The 64 voxels of row (y, z) starting at x, with the ones past the end
+    // of the row reading as empty.
+    uint64_t row_bits(size_t x, size_t y, size_t z) const;
+private:
+    size_t s_x;
+    size_t s_y;
+    size_t s_z;
+    size_t words_per_row;
+
+    std::vector<uint64_t> words;
+
+    size_t row_index(size_t y, size_t z) const
+    {
+        return (z * s_y + y) * words_per_row;
+    }
+};
+
+BitVolume::BitVolume(const Volume<Voxel>& volume)
+    : BitVolume(volume.size_x(), volume.size_y(), volume.size_z())
+{
+    for (size_t z = 0; z < s_z; ++z) {
+        for (size_t y = 0; y < s_y; ++y) {
+            uint64_t* row = &words[row_index(y, z)];
+            for (size_t x = 0; x < s_x; ++x) {
+                if (volume.at(x, y, z) != Voxel::empty) {
+                    row[x / word_bits] |= uint64_t(1) << (x % word_bits);
+                }
+            }
+        }
+    }
+}
+
+Voxel BitVolume::at(const size_t x, const size_t y, const size_t z) const
+{
+    assert(x < s_x);
+    assert(y < s_y);
+    assert(z < s_z);
+
+    const uint64_t word = words[row_index(y, z) + x / word_bits];
+    return (word >> (x % word_bits) & 1) ? Voxel::solid : Voxel::empty;
+}
+
+void BitVolume::set(
+        const size_t x, const size_t y, const size_t z, const Voxel voxel)
+{
+    assert(x < s_x);
+    assert(y < s_y);
+    assert(z < s_z);
+
+    uint64_t& word = words[row_index(y, z) + x / word_bits];
+    const uint64_t bit = uint64_t(1) << (x % word_bits);
+    if (voxel != Voxel::empty) {
+        word |= bit;
+    } else {
+        word &= ~bit;
+    }
+}
+
+uint64_t BitVolume::row_bits(
+        const size_t x, const size_t y, const size_t z) const
+{
+    assert(x < s_x);
+    assert(y < s_y);
+    assert(z < s_z);
+
+    const uint64_t* row = &words[row_index(y, z)];
+    const size_t word_index = x / word_bits;
+    const size_t shift = x % word_bits;
+
+    uint64_t bits = row[word_index] >> shift;
+    if (shift != 0 && word_index + 1 < words_per_row) {
+        bits |= row[word_index + 1] << (word_bits - shift);
+    }
+    return bits;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include "chunk.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Decides which of the chunks asked for during a frame start building, and
+// how many. Nearer chunks go first, and of equally near ones those in front
+// of the camera before those to its side or behind it. At most
+// max_builds_per_frame builds start per frame, and none while
+// max_builds_in_flight are still running, so that turning towards or
+// moving into hundreds of new chunks spreads their building and uploading
+// over many frames instead of stalling a few.
+//
+// Requests are forgotten at the end of every frame; chunks still wanted
+// have to be requested again, with the priority of their new position.
+class BuildScheduler
+{
+public:
+    BuildScheduler(size_t max_in_flight, size_t max_per_frame)
+        : max_builds_in_flight(max_in_flight)
+        , max_builds_per_frame(max_per_frame)
+    {
+        assert(max_builds_per_frame <= max_builds_in_flight);
+    }
+
+    // Where priorities are measured from, to be set before the requests of
+    // a frame.
+    void set_viewpoint(glm::vec3 position, glm::vec3 direction);
+
+    // At most once per chunk and frame.
+    void request(ChunkId);
+
+    // The chunks to start building this frame, given how many builds are
+    // running, highest priority first. Forgets all requests.
+    const std::vector<ChunkId>& take(size_t builds_in_flight);
+
+    // Lower is sooner: the distance from the viewpoint to the center of the
+    // chunk along x and z, up to 1 + behind_penalty times that for chunks
+    // right behind the viewpoint.
+    float priority(ChunkId) const;
+private:
+    static constexpr float behind_penalty = 2;
+
+    struct Request
+    {
+        float priority;
+        ChunkId chunk_id;
+    };
+
+    const size_t max_builds_in_flight;
+    const size_t max_builds_per_frame;
+
+    glm::vec3 viewpoint = glm::vec3(0.f);
+    // Along x and z, normalized, or zero when looking straight up or down.
+    glm::vec3 view_direction = glm::vec3(0.f);
+
+    // A heap with the lowest priority value on top. Kept between frames
+    // along with taken, to reuse their memory.
+    std::vector<Request> requests;
+    std::vector<ChunkId> taken;
+
+    static bool later(const Request&, const Request&);
+};
+
+void BuildScheduler::set_viewpoint(
+        const glm::vec3 position, const glm::vec3 direction)
+{
+    viewpoint = position;
+    const glm::vec3 horizontal(direction.x, 0.f, direction.z);
+    const float length = glm::length(horizontal);
+    view_direction = length > 0 ? horizontal / length : glm::vec3(0.f);
+}
+
+void BuildScheduler::request(const ChunkId chunk_id)
+{
+    requests.push_back({priority(chunk_id), chunk_id});
+    std::push_heap(requests.begin(), requests.end(), later);
+}
+
+const std::vector<ChunkId>& BuildScheduler::take(
+        const size_t builds_in_flight)
+{
+    taken.clear();
+    const size_t budget = builds_in_flight < max_builds_in_flight
+        ? std::min(max_builds_in_flight - builds_in_flight,
+                max_builds_per_frame)
+        : 0;
+    while (taken.size() < budget && !requests.empty()) {
+        std::pop_heap(requests.begin(), requests.end(), later);
+        taken.push_back(requests.back().chunk_id);
+        requests.pop_back();
+    }
+    requests.clear();
+    return taken;
+}
+
+float BuildScheduler::priority(const ChunkId chunk_id) const
+{
+    const glm::vec3 center =
+        glm::vec3(Chunks::begin_coord(chunk_id) + Chunks::end_coord(chunk_id))
+        / 2.f;
+    const glm::vec3 offset(center.x - viewpoint.x, 0.f, center.z - viewpoint.z);
+    const float distance = glm::length(offset);
+    if (distance == 0) {
+        return 0;
+    }
+    const float cos_angle = glm::dot(offset, view_direction) / distance;
+    return distance * (1 + behind_penalty * (1 - cos_angle) / 2);
+}
+
+bool BuildScheduler::later(const Request& lhs, const Request& rhs)
+{
+    return lhs.priority > rhs.priority;
+}
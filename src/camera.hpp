@@ -32,6 +32,7 @@ public:
     void look(float horizontal_angle, float vertical_angle);
 
     glm::vec3 get_position() const { return position; }
+    glm::vec3 get_direction() const { return direction; }
     void set_position(glm::vec3 new_position) { position = new_position; }
     void move(float distance);
     void move_right(float distance);
@@ -2,6 +2,7 @@
 
 #define GLM_FORCE_RADIANS
 
+#include <cstdint>
 #include <functional>
 #include <ostream>
 
@@ -47,6 +48,17 @@ constexpr int z_size = 64;
 constexpr int y_begin = 0;
 constexpr int y_end = 64;
 
+// Chunks are split along y into sections of this height, which are stored
+// and meshed on their own.
+constexpr int section_height = 16;
+constexpr int section_count = (y_end - y_begin) / section_height;
+static_assert((y_end - y_begin) % section_height == 0,
+        "chunks have to consist of whole sections");
+
+// One bit per section, from the bottom up.
+typedef uint32_t SectionSet;
+constexpr SectionSet all_sections = (SectionSet(1) << section_count) - 1;
+
 glm::ivec3 begin_coord(const ChunkId chunk_id)
 {
     return {chunk_id.x * x_size, y_begin, chunk_id.z * z_size};
@@ -70,4 +82,18 @@ glm::mat4 calc_translation(const ChunkId chunk_id)
                 x_size * chunk_id.x, 0.f, z_size * chunk_id.z));
 }
 
+// The sections whose meshes an edited voxel at the height can change. It
+// changes the faces and ambient occlusion of its direct neighbors, which may
+// lie in the sections above or below.
+SectionSet sections_around(const int world_y)
+{
+    SectionSet sections = 0;
+    for (int y = world_y - 1; y <= world_y + 1; ++y) {
+        if (y >= y_begin && y < y_end) {
+            sections |= SectionSet(1) << (y - y_begin) / section_height;
+        }
+    }
+    return sections;
+}
+
 }
@@ -1,82 +1,355 @@
 #pragma once
 
+#include "build_scheduler.hpp"
 #include "chunk_volume_repository.hpp"
 #include "mesh.hpp"
 #include "mesh_builder.hpp"
+#include "metrics.hpp"
+#include "recently_drawn.hpp"
+#include "worker_pool.hpp"
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
-struct TimestampedMesh
-{
-    Mesh mesh;
-    std::time_t last_access;
-};
-
+// Meshes are built on a pool of worker threads, sampling the volumes there
+// as well, and uploaded to the GPU on the thread calling update(). Apart
+// from the workers everything runs on that thread. Every section of a chunk
+// has a mesh of its own, sections without visible faces have none. Edits
+// only rebuild the sections they touch; until then the old meshes are
+// drawn. New chunks start building in the order and at the pace the
+// BuildScheduler allows.
+//
+// Keeps at most capacity meshes, evicting the least recently drawn ones
+// first. Meshes drawn during the current frame are never evicted, even if
+// that means going over the capacity until they are out of view.
 class ChunkMeshRepository
 {
 public:
-    ChunkMeshRepository(ChunkVolumeRepository& cvr, size_t cap)
-        : chunk_volume_repository(cvr), capacity(cap) {}
+    ChunkMeshRepository(
+            ChunkVolumeRepository& cvr,
+            size_t cap,
+            MeshBuilder::Mode mode,
+            size_t worker_count)
+        : chunk_volume_repository(cvr)
+        , capacity(cap)
+        , mesh_buffer_pool(mesh_buffer_pool_size)
+        , build_scheduler(
+                builds_in_flight_per_worker * worker_count,
+                builds_per_frame_per_worker * worker_count)
+        , mesh_builders(worker_count, MeshBuilder(mode))
+        , workers(worker_count) {}
 
+    // Removes the least recently drawn meshes right away if there are more
+    // than the new capacity.
+    void set_capacity(size_t);
+
+    // Where the chunks asked for are prioritized from, see BuildScheduler.
+    // To be set before drawing.
+    void set_viewpoint(glm::vec3 position, glm::vec3 direction)
+    {
+        build_scheduler.set_viewpoint(position, direction);
+    }
+
+    // Calls f with each section mesh of the chunk if it has been built
+    // already. Otherwise schedules building it and calls nothing for now.
     template <typename F>
     void with(ChunkId, F);
+
+    // Changes a voxel, see ChunkVolumeRepository::set_voxel. The edits of a
+    // frame are applied by update(), which rebuilds every section they
+    // touch once, no matter how many edits it got.
+    void set_voxel(glm::ivec3 world_pos, Voxel);
+
+    // To be called once per frame, after drawing. Uploads the meshes that
+    // have been built since the last call, applies the edits of the frame,
+    // cancels building the meshes that were not asked for during the frame
+    // and starts building the new ones that were, as far as the scheduler
+    // allows.
+    void update();
 private:
+    typedef std::shared_ptr<std::atomic<bool>> CancellationFlag;
+    typedef Chunks::SectionSet SectionSet;
+
+    static constexpr size_t mesh_buffer_pool_size = 16;
+
+    // Enough to keep the workers busy between two frames, few enough for
+    // the uploads of a frame to stay short.
+    static constexpr size_t builds_in_flight_per_worker = 4;
+    static constexpr size_t builds_per_frame_per_worker = 2;
+
+    typedef std::array<std::unique_ptr<Mesh>, Chunks::section_count>
+        SectionMeshes;
+
+    struct PendingBuild
+    {
+        CancellationFlag cancelled;
+        SectionSet sections;
+        bool requested;
+    };
+
+    struct FinishedBuild
+    {
+        ChunkId chunk_id;
+        CancellationFlag cancelled;
+        SectionSet sections;
+        // Indexed by section, empty for the sections that were not built.
+        std::vector<MeshData> section_mesh_data;
+    };
+
     ChunkVolumeRepository& chunk_volume_repository;
-    const size_t capacity;
+    size_t capacity;
 
-    std::unordered_map<ChunkId, TimestampedMesh> meshes;
-    MeshBuilder mesh_builder;
+    // Declared before the meshes, which return their buffers to it.
+    MeshBufferPool mesh_buffer_pool;
+    RecentlyDrawn<SectionMeshes> meshes;
+    std::unordered_map<ChunkId, PendingBuild> pending_builds;
+    std::vector<std::pair<glm::ivec3, Voxel>> pending_edits;
+    BuildScheduler build_scheduler;
+    // Indexed by worker, so that each worker reuses its own.
+    std::vector<MeshBuilder> mesh_builders;
 
-    Mesh& get_or_build(ChunkId);
-    Mesh build(ChunkId);
-    void remove_oldest_accessed();
-    Mesh& store(ChunkId, Mesh&&);
+    std::mutex finished_builds_mutex;
+    std::vector<FinishedBuild> finished_builds;
+
+    // Declared last so that the workers are stopped before anything they
+    // use is destroyed.
+    WorkerPool workers;
+
+    void request_build(ChunkId);
+    void submit_build(ChunkId, SectionSet, bool requested);
+    void build(ChunkId, SectionSet, CancellationFlag, size_t worker_index);
+    void upload(FinishedBuild&);
+    void apply_edits();
+    void evicted(size_t mesh_count);
 };
 
 template <typename F>
 void ChunkMeshRepository::with(const ChunkId chunk_id, const F f)
 {
-    f(get_or_build(chunk_id));
+    const SectionMeshes* const section_meshes = meshes.draw(chunk_id);
+    Metrics::add(section_meshes
+            ? Metrics::Counter::mesh_cache_hits
+            : Metrics::Counter::mesh_cache_misses);
+    if (section_meshes) {
+        for (const auto& mesh : *section_meshes) {
+            if (mesh) {
+                f(*mesh);
+            }
+        }
+    }
+    // Sections being rebuilt have to be asked for like new meshes.
+    request_build(chunk_id);
+}
+
+void ChunkMeshRepository::set_capacity(const size_t new_capacity)
+{
+    capacity = new_capacity;
+    evicted(meshes.shrink_to(capacity));
 }
 
-Mesh& ChunkMeshRepository::get_or_build(const ChunkId chunk_id)
+void ChunkMeshRepository::set_voxel(
+        const glm::ivec3 world_pos, const Voxel voxel)
 {
-    auto found = meshes.find(chunk_id);
-    if (found != meshes.end()) {
-        found->second.last_access = std::time(nullptr);
-        return found->second.mesh;
-    } else {
-        Mesh mesh = build(chunk_id);
-        if (meshes.size() == capacity) {
-            remove_oldest_accessed();
+    pending_edits.push_back({world_pos, voxel});
+}
+
+void ChunkMeshRepository::update()
+{
+    std::vector<FinishedBuild> finished;
+    {
+        std::lock_guard<std::mutex> lock(finished_builds_mutex);
+        finished.swap(finished_builds);
+    }
+
+    for (auto& finished_build : finished) {
+        // A build that has been cancelled and requested again since may
+        // still have finished; only the latest one counts.
+        auto pending = pending_builds.find(finished_build.chunk_id);
+        if (pending == pending_builds.end()
+                || pending->second.cancelled != finished_build.cancelled) {
+            continue;
         }
-        return store(chunk_id, std::move(mesh));
+        pending_builds.erase(pending);
+        Metrics::ScopedTimer timer(Metrics::Timer::upload_mesh);
+        upload(finished_build);
     }
+
+    apply_edits();
+
+    for (auto it = pending_builds.begin(); it != pending_builds.end(); ) {
+        if (it->second.requested) {
+            it->second.requested = false;
+            ++it;
+            continue;
+        }
+
+        Log::debug("Cancelling mesh at " << it->first);
+        *it->second.cancelled = true;
+        // The mesh of a chunk whose rebuild is cancelled is out of date.
+        meshes.erase(it->first);
+        it = pending_builds.erase(it);
+    }
+
+    // Not requested again until the next frame, so cancelled by the next
+    // update unless asked for meanwhile.
+    for (const ChunkId chunk_id : build_scheduler.take(pending_builds.size())) {
+        submit_build(chunk_id, Chunks::all_sections, false);
+    }
+
+    meshes.next_frame();
 }
 
-Mesh ChunkMeshRepository::build(ChunkId chunk_id)
+// Only chunks without a mesh get a new build, those with one are only
+// kept from being cancelled. New builds wait for update() to start them.
+void ChunkMeshRepository::request_build(const ChunkId chunk_id)
 {
-    Log::debug("Building mesh at " << chunk_id);
-    Mesh mesh;
-    chunk_volume_repository.with(chunk_id, [&](auto volume) {
-        mesh.build_vao(mesh_builder.build(volume));
-    });
-    return mesh;
+    auto pending = pending_builds.find(chunk_id);
+    if (pending != pending_builds.end()) {
+        pending->second.requested = true;
+    } else if (!meshes.find(chunk_id)) {
+        build_scheduler.request(chunk_id);
+    }
 }
 
-void ChunkMeshRepository::remove_oldest_accessed()
+void ChunkMeshRepository::submit_build(
+        const ChunkId chunk_id, const SectionSet sections, const bool requested)
 {
-    auto oldest_accessed = std::min_element(meshes.begin(), meshes.end(),
-            [](auto& a, auto& b) {
-        return a.second.last_access < b.second.last_access;
+    assert(pending_builds.find(chunk_id) == pending_builds.end());
+
+    CancellationFlag cancelled = std::make_shared<std::atomic<bool>>(false);
+    pending_builds.insert({ chunk_id,
+            PendingBuild { cancelled, sections, requested } });
+    workers.submit([=](size_t worker_index) {
+        this->build(chunk_id, sections, cancelled, worker_index);
     });
-    Log::debug("Removing mesh at " << oldest_accessed->first);
-    meshes.erase(oldest_accessed);
 }
 
-Mesh& ChunkMeshRepository::store(ChunkId chunk_id, Mesh&& mesh)
+// Replaces only the rebuilt section meshes of a chunk that has a mesh. A
+// chunk whose mesh has been removed while some of its sections were being
+// rebuilt is left to be built anew.
+void ChunkMeshRepository::upload(FinishedBuild& finished_build)
+{
+    SectionMeshes* section_meshes = meshes.find(finished_build.chunk_id);
+    if (!section_meshes) {
+        if (finished_build.sections != Chunks::all_sections) {
+            return;
+        }
+        evicted(meshes.make_room(capacity));
+        section_meshes =
+            &meshes.insert(finished_build.chunk_id, SectionMeshes());
+    }
+
+    for (size_t i = 0; i < section_meshes->size(); ++i) {
+        if (!(finished_build.sections >> i & 1)) {
+            continue;
+        }
+        MeshData& mesh_data = finished_build.section_mesh_data[i];
+        if (mesh_data.vertices.empty()) {
+            (*section_meshes)[i].reset();
+            continue;
+        }
+        if (!(*section_meshes)[i]) {
+            (*section_meshes)[i].reset(new Mesh(mesh_buffer_pool));
+        }
+        (*section_meshes)[i]->build_vao(std::move(mesh_data));
+    }
+}
+
+// Builds that are pending for an edited chunk may have seen its volume
+// before the edits, so they are replaced by one that covers their sections
+// as well.
+void ChunkMeshRepository::apply_edits()
 {
-    TimestampedMesh timestamped_mesh { mesh, std::time(nullptr) };
-    auto inserted = meshes.insert({ chunk_id, timestamped_mesh });
-    return inserted.first->second.mesh;
+    std::unordered_map<ChunkId, SectionSet> dirty_sections;
+    for (const auto& edit : pending_edits) {
+        const SectionSet sections = Chunks::sections_around(edit.first.y);
+        for (const ChunkId chunk_id
+                : chunk_volume_repository.set_voxel(edit.first, edit.second)) {
+            dirty_sections[chunk_id] |= sections;
+        }
+    }
+    pending_edits.clear();
+
+    for (const auto& dirty : dirty_sections) {
+        const ChunkId chunk_id = dirty.first;
+        SectionSet sections = dirty.second;
+        bool requested = true;
+
+        auto pending = pending_builds.find(chunk_id);
+        if (pending != pending_builds.end()) {
+            *pending->second.cancelled = true;
+            sections |= pending->second.sections;
+            requested = pending->second.requested;
+            pending_builds.erase(pending);
+        } else if (!meshes.find(chunk_id)) {
+            // Built from the edited volume once it is asked for.
+            continue;
+        }
+
+        Log::debug("Rebuilding sections " << sections << " at " << chunk_id);
+        submit_build(chunk_id, sections, requested);
+    }
+}
+
+// Runs on a worker thread.
+void ChunkMeshRepository::build(
+        const ChunkId chunk_id,
+        const SectionSet sections,
+        const CancellationFlag cancelled,
+        const size_t worker_index)
+{
+    if (*cancelled) {
+        return;
+    }
+
+    Log::debug("Building mesh at " << chunk_id);
+    Metrics::ScopedTimer timer(Metrics::Timer::build_mesh);
+    MeshBuilder& mesh_builder = mesh_builders[worker_index];
+    std::vector<MeshData> section_mesh_data(Chunks::section_count);
+    const auto build_sections = [&]() {
+        assert(mesh_builder.section_count() == Chunks::section_count);
+        for (size_t i = 0; i < mesh_builder.section_count(); ++i) {
+            if (sections >> i & 1) {
+                section_mesh_data[i] = mesh_builder.build_section(i);
+            }
+        }
+    };
+    if (chunk_volume_repository.has_heightmaps()
+            && !chunk_volume_repository.neighborhood_edited(chunk_id)) {
+        const Heightmap heightmap = chunk_volume_repository.heightmap(chunk_id);
+        mesh_builder.load(
+                heightmap,
+                Chunks::y_end - Chunks::y_begin,
+                ChunkVolumeRepository::heightmap_border_size);
+        build_sections();
+    } else {
+        chunk_volume_repository.with_neighborhood(chunk_id,
+                [&](const ChunkNeighborhood& neighborhood) {
+            if (!*cancelled) {
+                mesh_builder.load(neighborhood);
+                build_sections();
+            }
+        });
+    }
+    if (*cancelled) {
+        return;
+    }
+
+    Metrics::add(Metrics::Counter::chunks_meshed);
+    std::lock_guard<std::mutex> lock(finished_builds_mutex);
+    finished_builds.push_back(FinishedBuild {
+            chunk_id, cancelled, sections, std::move(section_mesh_data) });
+}
+
+// Counts the meshes that shrinking or making room removed.
+void ChunkMeshRepository::evicted(const size_t mesh_count)
+{
+    if (mesh_count > 0) {
+        Log::debug("Removed " << mesh_count << " meshes");
+        Metrics::add(Metrics::Counter::mesh_cache_evictions, mesh_count);
+    }
 }
@@ -0,0 +1,81 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include "sectioned_volume.hpp"
+#include "voxel.hpp"
+
+#include <array>
+#include <cassert>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+// Reads the volume of a chunk together with the adjacent voxels of the
+// eight chunks around it, as if it were a single volume with a one voxel
+// border, without copying any of them. Below the chunks everything is
+// solid and above them everything is empty.
+class ChunkNeighborhood
+{
+public:
+    typedef std::shared_ptr<const SectionedVolume> VolumePtr;
+
+    // Indexed by (dz + 1) * 3 + dx + 1 for the chunk at offset (dx, dz).
+    // All of the volumes have to be of the same size.
+    explicit ChunkNeighborhood(std::array<VolumePtr, 9>);
+
+    size_t size_x() const { return center().size_x() + 2; }
+    size_t size_y() const { return center().size_y() + 2; }
+    size_t size_z() const { return center().size_z() + 2; }
+
+    const SectionedVolume& center() const { return volume(0, 0); }
+    const SectionedVolume& volume(int dx, int dz) const;
+
+    Voxel at(size_t x, size_t y, size_t z) const;
+    Voxel at(glm::ivec3 v) const { return at(v.x, v.y, v.z); }
+private:
+    std::array<VolumePtr, 9> volumes;
+};
+
+ChunkNeighborhood::ChunkNeighborhood(std::array<VolumePtr, 9> vs)
+    : volumes(vs)
+{
+    for (size_t i = 0; i < volumes.size(); ++i) {
+        assert(volumes[i]);
+        assert(volumes[i]->size_x() == center().size_x());
+        assert(volumes[i]->size_y() == center().size_y());
+        assert(volumes[i]->size_z() == center().size_z());
+    }
+}
+
+const SectionedVolume& ChunkNeighborhood::volume(const int dx, const int dz)
+    const
+{
+    assert(dx >= -1 && dx <= 1);
+    assert(dz >= -1 && dz <= 1);
+
+    return *volumes[(dz + 1) * 3 + dx + 1];
+}
+
+Voxel ChunkNeighborhood::at(const size_t x, const size_t y, const size_t z)
+    const
+{
+    assert(x < size_x());
+    assert(y < size_y());
+    assert(z < size_z());
+
+    if (y == 0) {
+        return Voxel::solid;
+    } else if (y == size_y() - 1) {
+        return Voxel::empty;
+    }
+
+    const size_t inner_x = center().size_x();
+    const size_t inner_z = center().size_z();
+    const int dx = x == 0 ? -1 : x == inner_x + 1 ? 1 : 0;
+    const int dz = z == 0 ? -1 : z == inner_z + 1 ? 1 : 0;
+    return volume(dx, dz).at(
+            dx == 0 ? x - 1 : dx < 0 ? inner_x - 1 : 0,
+            y - 1,
+            dz == 0 ? z - 1 : dz < 0 ? inner_z - 1 : 0);
+}
@@ -1,50 +1,333 @@
 #pragma once
 
 #include "chunk.hpp"
+#include "chunk_neighborhood.hpp"
+#include "heightmap.hpp"
 #include "log.hpp"
+#include "metrics.hpp"
+#include "sectioned_volume.hpp"
 #include "volume.hpp"
 #include "voxel.hpp"
 
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
+// Volumes are sampled and stored without a border. The voxels a chunk needs
+// from its neighbors are read from their own volumes through a
+// ChunkNeighborhood instead, so none are sampled or stored twice.
+//
+// Volumes are stored in sections that are palette compressed on their own,
+// so a chunk of a few materials takes a few bits per voxel and sections of a
+// single one next to nothing. Safe to use from several threads. Volumes are
+// sampled outside of the lock, so different chunks can be sampled in
+// parallel.
+//
+// Keeps at most byte_budget bytes of volumes resident, evicting the least
+// recently used ones first. Volumes that are being used by a with() call
+// are never evicted, even if that means going over the budget for a while.
+// Edited volumes are never evicted at all, since they could not be sampled
+// again. Neither kind is kept in the eviction order, so evicting a volume
+// never has to skip any.
 class ChunkVolumeRepository
 {
 public:
     typedef std::function<Volume<Voxel>(glm::ivec3, glm::ivec3, int)> VolumeSampler;
+    typedef std::function<Heightmap(glm::ivec3, glm::ivec3, int)>
+        HeightmapSampler;
 
-    ChunkVolumeRepository(VolumeSampler vs, int bs)
+    struct Stats
+    {
+        size_t bytes_resident;
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+    };
+
+    ChunkVolumeRepository(VolumeSampler vs, size_t budget)
+        : volume_sampler(vs)
+        , byte_budget(budget) {}
+    // For heightfield terrain, whose volumes are filled by
+    // volume_from_heightmap from the heightmaps sampled by hs. Its chunks
+    // can be meshed from the heightmaps alone.
+    ChunkVolumeRepository(VolumeSampler vs, HeightmapSampler hs, size_t budget)
         : volume_sampler(vs)
-        , border_size(bs) {}
+        , heightmap_sampler(hs)
+        , byte_budget(budget) {}
+
+    // Heightmaps have the one voxel border that meshing needs.
+    static constexpr int heightmap_border_size = 1;
+
+    bool has_heightmaps() const { return bool(heightmap_sampler); }
+    // Samples the heightmap anew on every call, it is not stored.
+    Heightmap heightmap(ChunkId) const;
 
     template <typename F>
     void with(ChunkId, F);
+    // Calls f with the ChunkNeighborhood of the chunk, sampling any of the
+    // nine volumes that are missing first.
+    template <typename F>
+    void with_neighborhood(ChunkId, F);
+
+    // Changes the voxel at a world position in the volume of its chunk,
+    // sampling it first if needed. Returns the chunks whose neighborhoods
+    // contain the voxel. A volume in use by a with() call is left alone and
+    // replaced by an edited copy.
+    std::vector<ChunkId> set_voxel(glm::ivec3 world_pos, Voxel);
+    // Whether any volume of the neighborhood of the chunk has been edited
+    // since sampling, so that its heightmap no longer describes it.
+    bool neighborhood_edited(ChunkId);
+
+    Stats stats();
 private:
+    typedef std::shared_ptr<SectionedVolume> VolumePtr;
+
+    struct Entry
+    {
+        VolumePtr volume;
+        // Calls between acquire() and release() of the volume.
+        size_t users;
+        bool edited;
+        // Into lru_order if the volume can be evicted, see evictable(),
+        // into pinned otherwise.
+        std::list<ChunkId>::iterator lru_position;
+    };
+
     const VolumeSampler volume_sampler;
-    const int border_size;
+    const HeightmapSampler heightmap_sampler;
+    const size_t byte_budget;
 
-    std::unordered_map<ChunkId, Volume<Voxel>> volumes;
+    std::mutex mutex;
+    std::unordered_map<ChunkId, Entry> volumes;
+    // Of the volumes that can be evicted, most recently used first.
+    std::list<ChunkId> lru_order;
+    // The others, in no particular order. Entries move between the two
+    // lists by splicing, which allocates nothing.
+    std::list<ChunkId> pinned;
+    Stats current_stats {};
 
-    Volume<Voxel>& get_or_sample(ChunkId);
+    // Keeps the volume from being evicted until released, sampling it first
+    // if needed.
+    VolumePtr acquire(ChunkId);
+    void release(ChunkId);
+    VolumePtr find(ChunkId);
+    VolumePtr store(ChunkId, VolumePtr);
+    // The others are called with the lock held.
+    void pin(Entry&);
+    void evict_over_budget();
+
+    static bool evictable(const Entry& entry)
+    {
+        return entry.users == 0 && !entry.edited;
+    }
 };
 
 template <typename F>
 void ChunkVolumeRepository::with(const ChunkId chunk_id, const F f)
 {
-    f(get_or_sample(chunk_id));
+    // Holding the pointer keeps the volume from being edited meanwhile.
+    const std::shared_ptr<const SectionedVolume> volume = acquire(chunk_id);
+    f(*volume);
+    release(chunk_id);
 }
 
-Volume<Voxel>& ChunkVolumeRepository::get_or_sample(const ChunkId chunk_id)
+template <typename F>
+void ChunkVolumeRepository::with_neighborhood(const ChunkId chunk_id, const F f)
 {
-    auto found = volumes.find(chunk_id);
-    if (found != volumes.end()) {
-        return found->second;
-    } else {
-        Log::debug("Sampling volume at " << chunk_id);
-        const Volume<Voxel> volume = volume_sampler(
+    std::array<ChunkNeighborhood::VolumePtr, 9> neighbors;
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            neighbors[(dz + 1) * 3 + dx + 1] =
+                acquire({chunk_id.x + dx, chunk_id.z + dz});
+        }
+    }
+    f(ChunkNeighborhood(neighbors));
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            release({chunk_id.x + dx, chunk_id.z + dz});
+        }
+    }
+}
+
+Heightmap ChunkVolumeRepository::heightmap(const ChunkId chunk_id) const
+{
+    assert(has_heightmaps());
+
+    Log::debug("Sampling heightmap at " << chunk_id);
+    Metrics::add(Metrics::Counter::chunks_sampled);
+    Metrics::ScopedTimer timer(Metrics::Timer::sample_heightmap);
+    return heightmap_sampler(
+            Chunks::begin_coord(chunk_id),
+            Chunks::end_coord(chunk_id),
+            heightmap_border_size);
+}
+
+std::vector<ChunkId> ChunkVolumeRepository::set_voxel(
+        const glm::ivec3 world_pos, const Voxel voxel)
+{
+    assert(world_pos.y >= Chunks::y_begin && world_pos.y < Chunks::y_end);
+
+    const ChunkId home = Chunks::chunk_at(world_pos);
+    {
+        // Sampled outside of the lock, as in with(), and acquired until
+        // then so that it cannot be evicted.
+        VolumePtr sampled = acquire(home);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = volumes.find(home);
+        assert(found != volumes.end());
+        Entry& entry = found->second;
+        sampled.reset();
+        if (entry.volume.use_count() > 1) {
+            entry.volume = std::make_shared<SectionedVolume>(*entry.volume);
+        }
+        current_stats.bytes_resident -= entry.volume->byte_size();
+        entry.volume->set(world_pos - Chunks::begin_coord(home), voxel);
+        current_stats.bytes_resident += entry.volume->byte_size();
+        // Released without going back into the eviction order.
+        entry.edited = true;
+        --entry.users;
+        evict_over_budget();
+    }
+
+    // The voxel is in the neighborhood of a chunk if it is at most one
+    // voxel away from it.
+    std::vector<ChunkId> changed;
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            const ChunkId chunk_id = {home.x + dx, home.z + dz};
+            const glm::ivec3 local_pos =
+                world_pos - Chunks::begin_coord(chunk_id);
+            if (local_pos.x >= -1 && local_pos.x <= Chunks::x_size
+                    && local_pos.z >= -1 && local_pos.z <= Chunks::z_size) {
+                changed.push_back(chunk_id);
+            }
+        }
+    }
+    return changed;
+}
+
+bool ChunkVolumeRepository::neighborhood_edited(const ChunkId chunk_id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            auto found = volumes.find({chunk_id.x + dx, chunk_id.z + dz});
+            if (found != volumes.end() && found->second.edited) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+ChunkVolumeRepository::Stats ChunkVolumeRepository::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return current_stats;
+}
+
+ChunkVolumeRepository::VolumePtr ChunkVolumeRepository::acquire(
+        const ChunkId chunk_id)
+{
+    VolumePtr found = find(chunk_id);
+    if (found) {
+        return found;
+    }
+
+    Log::debug("Sampling volume at " << chunk_id);
+    Metrics::add(Metrics::Counter::chunks_sampled);
+    Metrics::ScopedTimer timer(Metrics::Timer::sample_volume);
+    VolumePtr volume = std::make_shared<SectionedVolume>(
+            volume_sampler(
                 Chunks::begin_coord(chunk_id),
                 Chunks::end_coord(chunk_id),
-                border_size);
-        auto inserted = volumes.insert({chunk_id, volume});
-        return inserted.first->second;
+                0),
+            0,
+            Chunks::section_height);
+
+    return store(chunk_id, volume);
+}
+
+// Volumes that are still used by others or edited stay out of the eviction
+// order. Anything the volumes in use kept over the budget can go now.
+void ChunkVolumeRepository::release(const ChunkId chunk_id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = volumes.find(chunk_id);
+    assert(found != volumes.end());
+    Entry& entry = found->second;
+    assert(entry.users > 0);
+    --entry.users;
+    if (evictable(entry)) {
+        lru_order.splice(lru_order.begin(), pinned, entry.lru_position);
+        evict_over_budget();
+    }
+}
+
+ChunkVolumeRepository::VolumePtr ChunkVolumeRepository::find(
+        const ChunkId chunk_id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = volumes.find(chunk_id);
+    if (found == volumes.end()) {
+        ++current_stats.misses;
+        return nullptr;
+    }
+
+    ++current_stats.hits;
+    pin(found->second);
+    return found->second.volume;
+}
+
+// Another thread may have sampled the same chunk meanwhile, in which case
+// its volume is kept.
+ChunkVolumeRepository::VolumePtr ChunkVolumeRepository::store(
+        const ChunkId chunk_id, VolumePtr volume)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = volumes.find(chunk_id);
+    if (found != volumes.end()) {
+        pin(found->second);
+        return found->second.volume;
+    }
+
+    pinned.push_front(chunk_id);
+    volumes.insert({ chunk_id, Entry { volume, 1, false, pinned.begin() } });
+    current_stats.bytes_resident += volume->byte_size();
+
+    evict_over_budget();
+    return volume;
+}
+
+void ChunkVolumeRepository::pin(Entry& entry)
+{
+    if (evictable(entry)) {
+        pinned.splice(pinned.begin(), lru_order, entry.lru_position);
+    }
+    ++entry.users;
+}
+
+// Every volume in the eviction order can be evicted, so each step evicts
+// the least recently used one.
+void ChunkVolumeRepository::evict_over_budget()
+{
+    while (current_stats.bytes_resident > byte_budget && !lru_order.empty()) {
+        auto entry = volumes.find(lru_order.back());
+        assert(entry != volumes.end());
+        assert(evictable(entry->second));
+
+        Log::debug("Evicting volume at " << entry->first);
+        current_stats.bytes_resident -= entry->second.volume->byte_size();
+        ++current_stats.evictions;
+        volumes.erase(entry);
+        lru_order.pop_back();
     }
 }
@@ -0,0 +1,155 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include "volume.hpp"
+#include "voxel.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// A volume of voxels stored as runs of equal voxels along each (x, z)
+// column, from the bottom up. Heightmap terrain takes a handful of runs per
+// column no matter how tall the volume is.
+class ColumnVolume
+{
+public:
+    struct Run
+    {
+        Voxel value;
+        uint8_t end_y;
+    };
+
+    // Empty of columns, to be filled with append_run.
+    ColumnVolume(size_t x, size_t y, size_t z);
+    explicit ColumnVolume(const Volume<Voxel>&);
+
+    size_t size_x() const { return s_x; }
+    size_t size_y() const { return s_y; }
+    size_t size_z() const { return s_z; }
+    size_t byte_size() const;
+    size_t run_count() const { return runs.size(); }
+
+    // Stacks height voxels of the value onto the column being filled.
+    // Columns are filled bottom up in order of z, then x, and the next one
+    // is started once the current one reaches the top.
+    void append_run(Voxel, size_t height);
+    bool complete() const { return column_begins.size() == s_x * s_z + 1; }
+
+    Voxel at(size_t x, size_t y, size_t z) const;
+    Voxel at(glm::ivec3 v) const { return at(v.x, v.y, v.z); }
+
+    // Calls f(begin_y, end_y, value) for every run of column (x, z), bottom
+    // up.
+    template <typename F>
+    void for_each_run_in_column(size_t x, size_t z, F) const;
+private:
+    size_t s_x;
+    size_t s_y;
+    size_t s_z;
+
+    std::vector<Run> runs;
+    // Index of the first run of every column, plus one past the last run.
+    std::vector<uint32_t> column_begins;
+
+    size_t column_index(size_t x, size_t z) const;
+    size_t filled_height() const;
+};
+
+ColumnVolume::ColumnVolume(const size_t x, const size_t y, const size_t z)
+    : s_x(x)
+    , s_y(y)
+    , s_z(z)
+    , column_begins(1, 0)
+{
+    assert(s_y <= UINT8_MAX);
+}
+
+ColumnVolume::ColumnVolume(const Volume<Voxel>& volume)
+    : ColumnVolume(volume.size_x(), volume.size_y(), volume.size_z())
+{
+    for (size_t z = 0; z < s_z; ++z) {
+        for (size_t x = 0; x < s_x; ++x) {
+            size_t begin_y = 0;
+            for (size_t y = 1; y <= s_y; ++y) {
+                if (y == s_y
+                        || volume.at(x, y, z) != volume.at(x, begin_y, z)) {
+                    append_run(volume.at(x, begin_y, z), y - begin_y);
+                    begin_y = y;
+                }
+            }
+        }
+    }
+    assert(complete());
+}
+
+size_t ColumnVolume::byte_size() const
+{
+    return runs.size() * sizeof(Run)
+        + column_begins.size() * sizeof(uint32_t);
+}
+
+void ColumnVolume::append_run(const Voxel value, const size_t height)
+{
+    assert(!complete());
+    assert(height > 0);
+
+    const size_t begin_y = filled_height();
+    const size_t end_y = begin_y + height;
+    assert(end_y <= s_y);
+
+    if (begin_y != 0 && runs.back().value == value) {
+        runs.back().end_y = end_y;
+    } else {
+        runs.push_back({value, (uint8_t) end_y});
+    }
+
+    if (end_y == s_y) {
+        column_begins.push_back(runs.size());
+    }
+}
+
+Voxel ColumnVolume::at(const size_t x, const size_t y, const size_t z) const
+{
+    assert(y < s_y);
+
+    const size_t column = column_index(x, z);
+    for (size_t i = column_begins[column]; ; ++i) {
+        assert(i < column_begins[column + 1]);
+        if (y < runs[i].end_y) {
+            return runs[i].value;
+        }
+    }
+}
+
+template <typename F>
+void ColumnVolume::for_each_run_in_column(
+        const size_t x, const size_t z, F f) const
+{
+    const size_t column = column_index(x, z);
+    size_t begin_y = 0;
+    for (size_t i = column_begins[column];
+            i < column_begins[column + 1];
+            ++i) {
+        f(begin_y, (size_t) runs[i].end_y, runs[i].value);
+        begin_y = runs[i].end_y;
+    }
+}
+
+size_t ColumnVolume::column_index(const size_t x, const size_t z) const
+{
+    assert(x < s_x);
+    assert(z < s_z);
+    assert(complete());
+
+    return z * s_x + x;
+}
+
+// The column being filled starts after the last complete one.
+size_t ColumnVolume::filled_height() const
+{
+    return runs.size() == column_begins.back() ? 0 : runs.back().end_y;
+}
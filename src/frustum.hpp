@@ -0,0 +1,58 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <array>
+
+#include <glm/glm.hpp>
+
+// The six planes bounding what a camera sees, extracted from its world to
+// clip transformation, with their normals pointing inwards.
+class Frustum
+{
+public:
+    explicit Frustum(const glm::mat4& world_to_clip);
+
+    // Whether the axis-aligned box from min to max is at least partly
+    // inside. Conservative: boxes just outside a corner or an edge of the
+    // frustum can pass as well.
+    bool intersects(glm::vec3 min, glm::vec3 max) const;
+private:
+    // A point p is on the inner side of a plane when
+    // dot(plane.xyz, p) + plane.w >= 0. The planes are not normalized,
+    // which the sign of that does not depend on.
+    std::array<glm::vec4, 6> planes;
+};
+
+// Clip coordinates inside the frustum satisfy -w <= x, y, z <= w, so every
+// plane is the last row of the matrix plus or minus one of the others.
+Frustum::Frustum(const glm::mat4& world_to_clip)
+{
+    // glm matrices are indexed by column first.
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(
+                world_to_clip[0][i], world_to_clip[1][i],
+                world_to_clip[2][i], world_to_clip[3][i]);
+    }
+    planes = {{
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2],
+    }};
+}
+
+// Tests the corner furthest along the normal of each plane: if even that
+// one is outside of a plane, the whole box is.
+bool Frustum::intersects(const glm::vec3 min, const glm::vec3 max) const
+{
+    for (const glm::vec4& plane : planes) {
+        const float x = plane.x >= 0 ? max.x : min.x;
+        const float y = plane.y >= 0 ? max.y : min.y;
+        const float z = plane.z >= 0 ? max.z : min.z;
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
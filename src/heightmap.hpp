@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
 class Heightmap
 {
 public:
@@ -13,6 +18,9 @@ public:
 
     uint8_t& at(size_t x, size_t z);
     uint8_t at(size_t, size_t) const;
+
+    uint8_t min_height() const;
+    uint8_t max_height() const;
 private:
     const size_t x_size_;
     const size_t z_size_;
@@ -35,3 +43,17 @@ uint8_t Heightmap::at(size_t x, size_t z) const
 
     return data_[z * z_size_ + x];
 }
+
+uint8_t Heightmap::min_height() const
+{
+    assert(!data_.empty());
+
+    return *std::min_element(data_.begin(), data_.end());
+}
+
+uint8_t Heightmap::max_height() const
+{
+    assert(!data_.empty());
+
+    return *std::max_element(data_.begin(), data_.end());
+}
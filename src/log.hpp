@@ -1,48 +1,430 @@
 #pragma once
 
+#include "ring_buffer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
 
-#ifndef NDEBUG
-
-#define INSERTER(msgs) [&](std::ostream& os) { os << msgs; }
-
-#define debug(msgs) log("DEBUG", __FILE__, __LINE__, INSERTER(msgs));
-#define info(msgs) log("INFO", __FILE__, __LINE__, INSERTER(msgs));
+// Levels below LOG_LEVEL are compiled out, arguments and all. Debug builds
+// log everything, release builds INFO and up.
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
 
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_LEVEL_INFO
 #else
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
 
-#define debug(inserter) nop()
-#define info(inserter) nop()
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define debug(msgs) Record(Log::Level::debug, __FILE__, __LINE__) << msgs
+#else
+#define debug(msgs) nop()
+#endif
 
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define info(msgs) Record(Log::Level::info, __FILE__, __LINE__) << msgs
+#else
+#define info(msgs) nop()
 #endif
 
+// Logging only copies the message arguments into a fixed size entry and
+// pushes it onto a lock-free ring buffer. A background thread formats and
+// writes the entries. When the buffer is full, entries are dropped rather
+// than blocking the caller, and the number dropped is logged instead.
+//
+// The background thread is the only one writing to the output, so nothing
+// else should write to it directly while it is set.
 namespace Log
 {
 
-std::string file_and_line(std::string, int);
+enum class Level : uint8_t { debug, info };
+
+// Entries fill a few cache lines; longer messages are cut short.
+constexpr size_t entry_size = 256;
+constexpr size_t buffered_entries = 4096;
+
+struct Entry
+{
+    const char* file;
+    int line;
+    Level level;
+    bool truncated;
+    uint16_t payload_size;
+    // Message arguments, each a type tag followed by its value.
+    char payload[entry_size - sizeof(const char*) - sizeof(int) - 4];
+};
+
+static_assert(sizeof(Entry) == entry_size, "entries have no padding");
+
+enum class Tag : char
+{
+    signed_integer,
+    unsigned_integer,
+    floating_point,
+    character,
+    string
+};
+
+// Collects the arguments of one message and pushes it when destroyed, at
+// the end of the logging statement.
+class Record
+{
+public:
+    Record(Level, const char* file, int line);
+    ~Record();
+
+    Record(const Record&) = delete;
+    Record& operator=(const Record&) = delete;
+
+    Record& operator<<(char);
+    Record& operator<<(const char*);
+    Record& operator<<(const std::string&);
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value, Record&>::type
+    operator<<(T);
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value, Record&>::type
+    operator<<(T);
+
+    // Anything else is formatted on the calling thread.
+    template <typename T>
+    typename std::enable_if<
+        !std::is_arithmetic<T>::value
+            && !std::is_convertible<T, const char*>::value
+            && !std::is_same<T, std::string>::value,
+        Record&>::type
+    operator<<(const T&);
+private:
+    Entry entry;
+
+    void append(Tag, const void* value, size_t size);
+    void append_string(const char*, size_t length);
+};
+
+class Logger
+{
+public:
+    Logger();
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void push(const Entry&);
+    // Returns once the writer is done with the previous output, which can
+    // be destroyed then.
+    void set_output(std::ostream&);
+    // Returns once every entry pushed before the call has been written and
+    // the output flushed.
+    void flush();
+    size_t dropped() const { return total_dropped; }
+private:
+    static constexpr std::chrono::milliseconds idle_sleep{1};
+    static constexpr int file_and_line_width = 32;
+
+    RingBuffer<Entry, buffered_entries> entries;
+    std::atomic<std::ostream*> output;
+    std::atomic<size_t> pushed;
+    std::atomic<size_t> written;
+    // Since the last report of them, and in total.
+    std::atomic<size_t> unreported_dropped;
+    std::atomic<size_t> total_dropped;
+    std::atomic<bool> stopping;
+    // Passes done by the writer. It reads the output at the start of every
+    // pass and is done with it at the end.
+    std::atomic<uint64_t> passes;
+
+    // Started last, once everything it uses is initialized.
+    std::thread thread;
+
+    void run();
+    void wait_for_pass() const;
+    static void write(const Entry&, std::ostream&);
+};
+
+Logger& logger();
+void set_output(std::ostream& os) { logger().set_output(os); }
+void flush() { logger().flush(); }
+size_t dropped() { return logger().dropped(); }
+const char* without_src_dir(const char* file);
+
+Record::Record(const Level level, const char* const file, const int line)
+{
+    entry.file = file;
+    entry.line = line;
+    entry.level = level;
+    entry.truncated = false;
+    entry.payload_size = 0;
+}
+
+Record::~Record()
+{
+    logger().push(entry);
+}
+
+Record& Record::operator<<(const char c)
+{
+    append(Tag::character, &c, sizeof(c));
+    return *this;
+}
+
+Record& Record::operator<<(const char* const s)
+{
+    append_string(s, std::strlen(s));
+    return *this;
+}
+
+Record& Record::operator<<(const std::string& s)
+{
+    append_string(s.data(), s.size());
+    return *this;
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value, Record&>::type
+Record::operator<<(const T value)
+{
+    if (std::is_signed<T>::value) {
+        const int64_t v = value;
+        append(Tag::signed_integer, &v, sizeof(v));
+    } else {
+        const uint64_t v = value;
+        append(Tag::unsigned_integer, &v, sizeof(v));
+    }
+    return *this;
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, Record&>::type
+Record::operator<<(const T value)
+{
+    const double v = value;
+    append(Tag::floating_point, &v, sizeof(v));
+    return *this;
+}
+
+template <typename T>
+typename std::enable_if<
+    !std::is_arithmetic<T>::value
+        && !std::is_convertible<T, const char*>::value
+        && !std::is_same<T, std::string>::value,
+    Record&>::type
+Record::operator<<(const T& value)
+{
+    thread_local std::ostringstream oss;
+    oss.str("");
+    oss << value;
+    const std::string& formatted = oss.str();
+    append_string(formatted.data(), formatted.size());
+    return *this;
+}
+
+void Record::append(const Tag tag, const void* const value, const size_t size)
+{
+    if (entry.payload_size + 1 + size > sizeof(entry.payload)) {
+        entry.truncated = true;
+        return;
+    }
+    entry.payload[entry.payload_size] = char(tag);
+    std::memcpy(entry.payload + entry.payload_size + 1, value, size);
+    entry.payload_size += 1 + size;
+}
+
+// Stored as the tag, a 16-bit length and the characters.
+void Record::append_string(const char* const s, const size_t length)
+{
+    const size_t header_size = 1 + sizeof(uint16_t);
+    if (entry.payload_size + header_size > sizeof(entry.payload)) {
+        entry.truncated = true;
+        return;
+    }
+    const size_t space =
+        sizeof(entry.payload) - entry.payload_size - header_size;
+    const uint16_t stored = uint16_t(std::min(length, space));
+    entry.truncated |= stored < length;
+
+    char* const out = entry.payload + entry.payload_size;
+    out[0] = char(Tag::string);
+    std::memcpy(out + 1, &stored, sizeof(stored));
+    std::memcpy(out + header_size, s, stored);
+    entry.payload_size += header_size + stored;
+}
+
+constexpr std::chrono::milliseconds Logger::idle_sleep;
+
+Logger::Logger()
+    : output(&std::cout)
+    , pushed(0)
+    , written(0)
+    , unreported_dropped(0)
+    , total_dropped(0)
+    , stopping(false)
+    , passes(0)
+    , thread([this]() { run(); })
+{}
+
+Logger::~Logger()
+{
+    stopping = true;
+    thread.join();
+}
+
+void Logger::push(const Entry& entry)
+{
+    if (entries.try_push(entry)) {
+        pushed.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        unreported_dropped.fetch_add(1, std::memory_order_relaxed);
+        total_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Logger::set_output(std::ostream& os)
+{
+    flush();
+    output = &os;
+    wait_for_pass();
+}
+
+void Logger::flush()
+{
+    const size_t target = pushed.load();
+    while (written.load() < target) {
+        std::this_thread::sleep_for(idle_sleep);
+    }
+    wait_for_pass();
+}
+
+// The pass in progress may still be writing to or flushing the output it
+// started with, so it is the end of the next pass that is waited for.
+void Logger::wait_for_pass() const
+{
+    const uint64_t pass = passes.load();
+    while (passes.load() == pass) {
+        std::this_thread::sleep_for(idle_sleep);
+    }
+}
+
+// Writes what has been pushed in batches, flushing the output only once
+// the buffer has been drained. Drains everything before stopping.
+void Logger::run()
+{
+    Entry entry;
+    for (;;) {
+        std::ostream& os = *output;
+        bool wrote = false;
+        while (entries.try_pop(entry)) {
+            write(entry, os);
+            written.fetch_add(1, std::memory_order_release);
+            wrote = true;
+        }
+
+        const size_t dropped = unreported_dropped.exchange(0);
+        if (dropped > 0) {
+            os << std::left << std::setw(6) << "WARN"
+                << std::setw(file_and_line_width) << ""
+                << "Dropped " << dropped
+                << " log messages, the buffer was full\n";
+            wrote = true;
+        }
+
+        if (wrote) {
+            os.flush();
+        } else if (stopping) {
+            ++passes;
+            return;
+        } else {
+            std::this_thread::sleep_for(idle_sleep);
+        }
+        ++passes;
+    }
+}
+
+void Logger::write(const Entry& entry, std::ostream& os)
+{
+    static const char* const level_names[] = { "DEBUG", "INFO" };
+
+    // Padded by hand, without formatting into a temporary string.
+    const char* const file = without_src_dir(entry.file);
+    char line[16];
+    const int line_length =
+        std::snprintf(line, sizeof(line), ":%d", entry.line);
+    const int padding = file_and_line_width
+        - int(std::strlen(file)) - line_length;
+    os << std::left << std::setw(6) << level_names[size_t(entry.level)]
+        << file << line;
+    for (int i = 0; i < padding; ++i) {
+        os.put(' ');
+    }
+    os << std::right;
+
+    for (size_t i = 0; i < entry.payload_size; ) {
+        const Tag tag = Tag(entry.payload[i++]);
+        const char* const value = entry.payload + i;
+        switch (tag) {
+        case Tag::signed_integer: {
+            int64_t v;
+            std::memcpy(&v, value, sizeof(v));
+            os << v;
+            i += sizeof(v);
+            break;
+        }
+        case Tag::unsigned_integer: {
+            uint64_t v;
+            std::memcpy(&v, value, sizeof(v));
+            os << v;
+            i += sizeof(v);
+            break;
+        }
+        case Tag::floating_point: {
+            double v;
+            std::memcpy(&v, value, sizeof(v));
+            os << v;
+            i += sizeof(v);
+            break;
+        }
+        case Tag::character:
+            os << *value;
+            i += 1;
+            break;
+        case Tag::string: {
+            uint16_t length;
+            std::memcpy(&length, value, sizeof(length));
+            os.write(value + sizeof(length), length);
+            i += sizeof(length) + length;
+            break;
+        }
+        }
+    }
+    if (entry.truncated) {
+        os << "...";
+    }
+    os << '\n';
+}
 
-void log(
-        const std::string level,
-        const std::string file,
-        const int line,
-        const std::function<void(std::ostream&)> inserter)
+Logger& logger()
 {
-    std::cout
-        << std::left
-        << std::setw(6) << level
-        << std::setw(32) << file_and_line(file, line);
-    inserter(std::cout);
-    std::cout << std::endl;
+    static Logger logger;
+    return logger;
 }
 
-std::string file_and_line(std::string file, const int line)
+const char* without_src_dir(const char* const file)
 {
-    file.erase(0, 4); // Remove "src/"
-    std::ostringstream oss;
-    oss << file << ':' << line;
-    return oss.str();
+    return std::strncmp(file, "src/", 4) == 0 ? file + 4 : file;
 }
 
 void nop() {}
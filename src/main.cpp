@@ -6,12 +6,18 @@
 #include "chunk_volume_repository.hpp"
 #include "log.hpp"
 #include "mesh.hpp"
+#include "metrics.hpp"
+#include "noise_terrain.hpp"
 #include "uniform.hpp"
+#include "visible_chunks.hpp"
 #include "volume.hpp"
 #include "volumegen.hpp"
 #include "voxel.hpp"
 
+#include <chrono>
+#include <cstdlib>
 #include <fstream>
+#include <iostream>
 #include <sstream>
 #include <vector>
 
@@ -28,7 +34,9 @@ struct SdlState
 };
 
 SdlState initialize();
+void run(SdlState, GLuint program_id);
 void cleanup(SdlState);
+void fill_sphere(ChunkMeshRepository&, glm::vec3 center, int radius, Voxel);
 
 Volume<Voxel> create_volume(size_t z, size_t y, size_t x);
 
@@ -39,8 +47,28 @@ std::string read_resource_from_file(std::string);
 constexpr int screen_width = 1280;
 constexpr int screen_height = 720;
 
+constexpr size_t volume_byte_budget = 64 << 20;
+// In chunks from the one the camera is in. Page up and down change it, up
+// to about as far as the far clipping plane.
+constexpr int initial_view_radius = 6;
+constexpr int max_view_radius =
+    int(camera::far_clipping_plane_dist / Chunks::x_size);
+
+constexpr std::chrono::seconds metrics_summary_interval(5);
+
+// The left mouse button blasts a sphere of voxels this far in front of the
+// camera away, the right one fills it with dirt.
+constexpr float edit_distance = 16.f;
+constexpr int edit_radius = 4;
+
 int main()
 {
+    // Set to a file name to write a Chrome trace of the whole run to it.
+    const char* const trace_path = std::getenv("VOXEL_TRACE");
+    if (trace_path != nullptr) {
+        Metrics::start_trace();
+    }
+
     SdlState sdl_state = initialize();
 
     int gl_major_version;
@@ -59,19 +87,46 @@ int main()
             {vertex_shader_id, fragment_shader_id});
     glUseProgram(program_id);
 
-    auto sample_volume = [](glm::ivec3 begin, glm::ivec3 end, int border) {
-        auto heightmap = sample_heightmap(begin, end, border);
-        return volume_from_heightmap(heightmap, end.y - begin.y, border);
-    };
-    ChunkVolumeRepository chunk_volume_repository(sample_volume, 1);
-    ChunkMeshRepository chunk_mesh_repository(chunk_volume_repository, 50);
+    // Everything holding GL objects is gone by the time run returns, while
+    // there is still a context to delete them in.
+    run(sdl_state, program_id);
+    cleanup(sdl_state);
+
+    if (trace_path != nullptr) {
+        std::ofstream trace_file(trace_path);
+        Metrics::write_trace(trace_file);
+    }
+
+    return 0;
+}
+
+void run(const SdlState sdl_state, const GLuint program_id)
+{
+    const NoiseTerrain terrain(NoiseTerrain::Settings{});
+    auto sample_volume =
+        [terrain](glm::ivec3 begin, glm::ivec3 end, int border) {
+            return terrain.volume(begin, end, border);
+        };
+    auto sample_heights =
+        [terrain](glm::ivec3 begin, glm::ivec3 end, int border) {
+            return terrain.heightmap(begin, end, border);
+        };
+    ChunkVolumeRepository chunk_volume_repository(
+            sample_volume, sample_heights, volume_byte_budget);
+    // Room for the meshes of every chunk in range, so that turning around
+    // does not rebuild them.
+    ChunkMeshRepository chunk_mesh_repository(
+            chunk_volume_repository,
+            VisibleChunks::count_in_range(initial_view_radius),
+            MeshBuilder::Mode::greedy,
+            WorkerPool::default_thread_count());
 
     constexpr float aspect_ratio = screen_width / (float) screen_height;
     Camera camera(aspect_ratio);
     camera.set_position({0.f, 80.f, 0.f});
 
     Uniform<glm::mat4> model_to_clip(program_id, "modelToClip");
-    model_to_clip.set(camera.calc_world_to_clip());
+    VisibleChunks visible_chunks(initial_view_radius);
 
     glEnable(GL_CULL_FACE);
     glEnable(GL_DEPTH_TEST);
@@ -80,8 +135,12 @@ int main()
     float velocity_forward = 0.f;
     float velocity_right = 0.f;
 
+    auto last_metrics_summary = std::chrono::steady_clock::now();
+
     bool quit = false;
     while (!quit) {
+        Metrics::ScopedTimer frame_timer(Metrics::Timer::frame);
+
         SDL_Event sdl_event;
         while (SDL_PollEvent(&sdl_event)) {
             if (sdl_event.type == SDL_QUIT) {
@@ -96,7 +155,16 @@ int main()
                         || sc == SDL_SCANCODE_KP_MINUS) {
                     float sign = sc == SDL_SCANCODE_KP_PLUS ? 1.f : -1.f;
                     camera.set_fov(camera.get_fov() + sign * M_PI / 36.f);
-                    model_to_clip.set(camera.calc_world_to_clip());
+                } else if (sc == SDL_SCANCODE_PAGEUP
+                        || sc == SDL_SCANCODE_PAGEDOWN) {
+                    const int radius = glm::clamp(
+                            visible_chunks.get_view_radius()
+                                + (sc == SDL_SCANCODE_PAGEUP ? 1 : -1),
+                            1, max_view_radius);
+                    visible_chunks.set_view_radius(radius);
+                    chunk_mesh_repository.set_capacity(
+                            VisibleChunks::count_in_range(radius));
+                    Log::info("View radius " << radius << " chunks");
                 } else if (sc == SDL_SCANCODE_W || sc == SDL_SCANCODE_UP) {
                     velocity_forward = 0.5f;
                 } else if (sc == SDL_SCANCODE_S || sc == SDL_SCANCODE_DOWN) {
@@ -115,48 +183,92 @@ int main()
                         || sc == SDL_SCANCODE_D || sc == SDL_SCANCODE_RIGHT) {
                     velocity_right = 0.f;
                 }
+            } else if (sdl_event.type == SDL_MOUSEBUTTONDOWN) {
+                const Uint8 button = sdl_event.button.button;
+                if (button == SDL_BUTTON_LEFT || button == SDL_BUTTON_RIGHT) {
+                    fill_sphere(chunk_mesh_repository,
+                            camera.get_position()
+                                + edit_distance * camera.get_direction(),
+                            edit_radius,
+                            button == SDL_BUTTON_LEFT
+                                ? Voxel::empty : Voxel::dirt);
+                }
             } else if (sdl_event.type == SDL_MOUSEMOTION) {
                 const float hor_angle = camera.get_horizontal_angle()
                     - sdl_event.motion.xrel * M_PI / 360.f;
                 const float ver_angle = camera.get_vertical_angle()
                     - sdl_event.motion.yrel * M_PI / 360.f;
                 camera.look(hor_angle, ver_angle);
-                model_to_clip.set(camera.calc_world_to_clip());
             }
         }
 
         if (velocity_forward != 0.f || velocity_right != 0.f) {
             camera.move(velocity_forward);
             camera.move_right(velocity_right);
-            model_to_clip.set(camera.calc_world_to_clip());
         }
+        visible_chunks.update(camera);
+        chunk_mesh_repository.set_viewpoint(
+                camera.get_position(), camera.get_direction());
+        Metrics::add(Metrics::Counter::chunks_visible,
+                visible_chunks.chunks().size());
+        Metrics::add(Metrics::Counter::chunks_culled,
+                visible_chunks.culled_count());
 
         glClearColor(0.39f, 0.58f, 0.93f, 1.f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        const ChunkId player_chunk = Chunks::chunk_at(camera.get_position());
-        for (int dz = -2; dz <= 2; ++dz) {
-            for (int dx = -2; dx <= 2; ++dx) {
-                const ChunkId visible_chunk =
-                    {player_chunk.x + dx, player_chunk.z + dz};
-
+        {
+            Metrics::ScopedTimer draw_timer(Metrics::Timer::draw);
+            const glm::mat4& world_to_clip = visible_chunks.world_to_clip();
+            for (const ChunkId visible_chunk : visible_chunks.chunks()) {
                 const glm::mat4 model_to_world =
                     Chunks::calc_translation(visible_chunk);
-                const glm::mat4 world_to_clip = camera.calc_world_to_clip();
                 model_to_clip.set(world_to_clip * model_to_world);
 
-                chunk_mesh_repository.with(visible_chunk, [](const Mesh& mesh) {
-                    mesh.draw();
-                });
+                chunk_mesh_repository.with(visible_chunk,
+                        [](const Mesh& mesh) { mesh.draw(); });
             }
         }
+        {
+            Metrics::ScopedTimer update_timer(Metrics::Timer::update_meshes);
+            chunk_mesh_repository.update();
+        }
 
         SDL_GL_SwapWindow(sdl_state.window);
-    }
 
-    cleanup(sdl_state);
+        const auto now = std::chrono::steady_clock::now();
+        if (now - last_metrics_summary >= metrics_summary_interval) {
+            // Through the logger, which owns standard output.
+            std::ostringstream summary;
+            Metrics::write_summary(summary);
+            std::istringstream summary_lines(summary.str());
+            for (std::string line; std::getline(summary_lines, line); ) {
+                Log::info(line);
+            }
+            last_metrics_summary = now;
+        }
+    }
+}
 
-    return 0;
+// Voxels above or below the chunks are left out.
+void fill_sphere(
+        ChunkMeshRepository& chunk_mesh_repository,
+        const glm::vec3 center,
+        const int radius,
+        const Voxel voxel)
+{
+    const glm::ivec3 center_voxel(glm::floor(center));
+    for (int dz = -radius; dz <= radius; ++dz) {
+        for (int dy = -radius; dy <= radius; ++dy) {
+            for (int dx = -radius; dx <= radius; ++dx) {
+                const glm::ivec3 pos = center_voxel + glm::ivec3(dx, dy, dz);
+                if (dx * dx + dy * dy + dz * dz <= radius * radius
+                        && pos.y >= Chunks::y_begin && pos.y < Chunks::y_end) {
+                    chunk_mesh_repository.set_voxel(pos, voxel);
+                }
+            }
+        }
+    }
 }
 
 SdlState initialize()
@@ -2,97 +2,222 @@
 
 #define GLM_FORCE_RADIANS
 
+#include "mesh_data.hpp"
+#include "metrics.hpp"
+#include "vertex.hpp"
+
 #include <vector>
 
 #include <GL/glew.h>
 #include <GL/gl.h>
 #include <glm/glm.hpp>
 
-struct MeshData
+// The GL objects of a mesh. The vertex array is set up to read from the two
+// buffers, so a recycled set only needs new buffer data.
+struct MeshBuffers
 {
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> normals;
-    std::vector<GLubyte> brightnesses;
+    GLuint vao_id;
+    GLuint vertex_vbo_id;
+    GLuint index_vbo_id;
+};
+
+// Recycles the GL objects of destroyed meshes for new ones, keeping at most
+// max_free sets of them around unused.
+class MeshBufferPool
+{
+public:
+    explicit MeshBufferPool(size_t mf) : max_free(mf) {}
+    ~MeshBufferPool();
+
+    MeshBufferPool(const MeshBufferPool&) = delete;
+    MeshBufferPool& operator=(const MeshBufferPool&) = delete;
+
+    MeshBuffers acquire();
+    void release(MeshBuffers);
+private:
+    static constexpr GLuint vertex_attr_index = 0;
+
+    const size_t max_free;
+    std::vector<MeshBuffers> free_buffers;
+
+    static MeshBuffers create();
+    static void destroy(MeshBuffers);
 };
 
+// Owns its GL objects, returning them to the pool when destroyed. The pool
+// has to outlive the mesh.
 class Mesh
 {
 public:
-    Mesh();
+    // Whether build_vao keeps the mesh data on the CPU side after uploading,
+    // or frees it right away.
+    enum class CpuCopy { discard, keep };
+
+    explicit Mesh(MeshBufferPool&);
+    ~Mesh();
+
+    Mesh(Mesh&&);
+    Mesh& operator=(Mesh&&);
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
 
     void clear();
-    void build_vao(MeshData&&);
+    void build_vao(MeshData&&, CpuCopy = CpuCopy::discard);
     void draw() const;
+
+    // Empty unless build_vao was asked to keep it.
+    const MeshData& data() const { return kept_data; }
 private:
-    static constexpr GLuint position_attr_index = 0;
-    static constexpr GLuint normal_attr_index = 1;
-    static constexpr GLuint brightness_attr_index = 2;
+    MeshBufferPool* pool;
+    MeshBuffers buffers;
 
     bool empty = true;
 
-    MeshData data;
-
-    GLuint vao_id;
-    GLuint position_vbo_id;
-    GLuint normal_vbo_id;
-    GLuint brightness_vbo_id;
+    MeshData kept_data;
+    GLsizei index_count = 0;
+    GLenum index_type = GL_UNSIGNED_INT;
 };
 
-Mesh::Mesh()
+MeshBufferPool::~MeshBufferPool()
+{
+    for (const auto buffers : free_buffers) {
+        destroy(buffers);
+    }
+}
+
+MeshBuffers MeshBufferPool::acquire()
+{
+    if (free_buffers.empty()) {
+        return create();
+    }
+    const MeshBuffers buffers = free_buffers.back();
+    free_buffers.pop_back();
+    return buffers;
+}
+
+void MeshBufferPool::release(const MeshBuffers buffers)
+{
+    if (free_buffers.size() < max_free) {
+        free_buffers.push_back(buffers);
+    } else {
+        destroy(buffers);
+    }
+}
+
+MeshBuffers MeshBufferPool::create()
 {
-    glGenVertexArrays(1, &vao_id);
-    glBindVertexArray(vao_id);
-    glEnableVertexAttribArray(position_attr_index);
-    glEnableVertexAttribArray(normal_attr_index);
-    glEnableVertexAttribArray(brightness_attr_index);
-
-    glGenBuffers(1, &position_vbo_id);
-    glBindBuffer(GL_ARRAY_BUFFER, position_vbo_id);
-    glVertexAttribPointer(
-            position_attr_index, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glGenBuffers(1, &normal_vbo_id);
-    glBindBuffer(GL_ARRAY_BUFFER, normal_vbo_id);
-    glVertexAttribPointer(
-            normal_attr_index, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glGenBuffers(1, &brightness_vbo_id);
-    glBindBuffer(GL_ARRAY_BUFFER, brightness_vbo_id);
-    glVertexAttribPointer(
-            brightness_attr_index, 1, GL_UNSIGNED_BYTE, GL_TRUE, 0, nullptr);
+    MeshBuffers buffers;
+
+    glGenVertexArrays(1, &buffers.vao_id);
+    glBindVertexArray(buffers.vao_id);
+    glEnableVertexAttribArray(vertex_attr_index);
+
+    glGenBuffers(1, &buffers.vertex_vbo_id);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vertex_vbo_id);
+    glVertexAttribIPointer(
+            vertex_attr_index, 1, GL_UNSIGNED_INT, 0, nullptr);
+
+    glGenBuffers(1, &buffers.index_vbo_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.index_vbo_id);
+
+    return buffers;
+}
+
+void MeshBufferPool::destroy(const MeshBuffers buffers)
+{
+    glDeleteVertexArrays(1, &buffers.vao_id);
+    glDeleteBuffers(1, &buffers.vertex_vbo_id);
+    glDeleteBuffers(1, &buffers.index_vbo_id);
+}
+
+Mesh::Mesh(MeshBufferPool& mesh_buffer_pool)
+    : pool(&mesh_buffer_pool)
+    , buffers(mesh_buffer_pool.acquire())
+{}
+
+Mesh::~Mesh()
+{
+    if (pool != nullptr) {
+        pool->release(buffers);
+    }
+}
+
+Mesh::Mesh(Mesh&& other)
+    : pool(other.pool)
+    , buffers(other.buffers)
+    , empty(other.empty)
+    , kept_data(std::move(other.kept_data))
+    , index_count(other.index_count)
+    , index_type(other.index_type)
+{
+    other.pool = nullptr;
+}
+
+Mesh& Mesh::operator=(Mesh&& other)
+{
+    if (this != &other) {
+        if (pool != nullptr) {
+            pool->release(buffers);
+        }
+        pool = other.pool;
+        buffers = other.buffers;
+        empty = other.empty;
+        kept_data = std::move(other.kept_data);
+        index_count = other.index_count;
+        index_type = other.index_type;
+        other.pool = nullptr;
+    }
+    return *this;
 }
 
 void Mesh::clear()
 {
     empty = true;
+    kept_data = {};
 }
 
-void Mesh::build_vao(MeshData&& new_data)
+void Mesh::build_vao(MeshData&& data, const CpuCopy cpu_copy)
 {
-    data = std::move(new_data);
-
-    glBindVertexArray(vao_id);
+    glBindVertexArray(buffers.vao_id);
 
-    glBindBuffer(GL_ARRAY_BUFFER, position_vbo_id);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vertex_vbo_id);
     glBufferData(
             GL_ARRAY_BUFFER,
-            data.positions.size() * sizeof(glm::vec3),
-            data.positions.data(),
+            data.vertices.size() * sizeof(PackedVertex),
+            data.vertices.data(),
             GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, normal_vbo_id);
-    glBufferData(
-            GL_ARRAY_BUFFER,
-            data.normals.size() * sizeof(glm::vec3),
-            data.normals.data(),
-            GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.index_vbo_id);
+    if (data.indices.empty()) {
+        index_count = data.short_indices.size();
+        index_type = GL_UNSIGNED_SHORT;
+        glBufferData(
+                GL_ELEMENT_ARRAY_BUFFER,
+                data.short_indices.size() * sizeof(uint16_t),
+                data.short_indices.data(),
+                GL_STATIC_DRAW);
+    } else {
+        index_count = data.indices.size();
+        index_type = GL_UNSIGNED_INT;
+        glBufferData(
+                GL_ELEMENT_ARRAY_BUFFER,
+                data.indices.size() * sizeof(uint32_t),
+                data.indices.data(),
+                GL_STATIC_DRAW);
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, brightness_vbo_id);
-    glBufferData(
-            GL_ARRAY_BUFFER,
-            data.brightnesses.size() * sizeof(GLubyte),
-            data.brightnesses.data(),
-            GL_STATIC_DRAW);
+    Metrics::add(Metrics::Counter::gl_upload_bytes,
+            data.vertices.size() * sizeof(PackedVertex)
+            + data.short_indices.size() * sizeof(uint16_t)
+            + data.indices.size() * sizeof(uint32_t));
+
+    if (cpu_copy == CpuCopy::keep) {
+        kept_data = std::move(data);
+    } else {
+        kept_data = {};
+        // Frees the caller's copy now rather than whenever its owner goes.
+        data = {};
+    }
 
     empty = false;
 }
@@ -100,7 +225,8 @@ void Mesh::build_vao(MeshData&& new_data)
 void Mesh::draw() const
 {
     if (!empty) {
-        glBindVertexArray(vao_id);
-        glDrawArrays(GL_TRIANGLES, 0, data.positions.size());
+        glBindVertexArray(buffers.vao_id);
+        glDrawElements(GL_TRIANGLES, index_count, index_type, nullptr);
+        Metrics::add(Metrics::Counter::vertices_drawn, index_count);
     }
 }
@@ -2,104 +2,528 @@
 
 #define GLM_FORCE_RADIANS
 
-#include "mesh.hpp"
+#include "bit_volume.hpp"
+#include "chunk_neighborhood.hpp"
+#include "column_volume.hpp"
+#include "heightmap.hpp"
+#include "mesh_data.hpp"
+#include "palette_volume.hpp"
+#include "sectioned_volume.hpp"
+#include "solid_masks.hpp"
+#include "vertex_index_table.hpp"
 #include "volume.hpp"
+#include "volumegen.hpp"
 #include "voxel.hpp"
 
 #include <algorithm>
-#include <map>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <vector>
 
 #include <glm/glm.hpp>
 
-struct Vec3Comparator
-{
-    bool operator()(const glm::vec3& v1, const glm::vec3& v2) const
-    {
-        return v1.x != v2.x ? v1.x < v2.x
-            : v1.y != v2.y ? v1.y < v2.y
-            : v1.z < v2.z;
-    }
-};
-
 class MeshBuilder
 {
 public:
-    MeshData build(const Volume<Voxel>);
+    // Per-face emits two triangles for every exposed voxel face, greedy
+    // merges coplanar faces of matching material and brightness into larger
+    // quads.
+    enum class Mode { per_face, greedy };
+
+    MeshBuilder(Mode m = Mode::per_face) : mode(m) {}
+
+    // Loads the volume to mesh, which has to stay alive while building.
+    // Its border voxels are considered neighbors and are not included in
+    // the mesh.
+    void load(const Volume<Voxel>&);
+    void load(const BitVolume&);
+    void load(const PaletteVolume<Voxel>&);
+    void load(const ColumnVolume&);
+    void load(const SectionedVolume&);
+    void load(const ChunkNeighborhood&);
+    // The terrain volume_from_heightmap would fill, straight from the
+    // heightmap.
+    void load(const Heightmap&, size_t y_size, size_t border_size);
+
+    // Sections as in Chunks::section_height, counted from the bottom of the
+    // volume's interior.
+    size_t section_count() const { return solid_masks.section_count(); }
+
+    // Meshes all of the loaded volume, or just the voxels of one section.
+    // Sections without visible faces are skipped without looking at them.
+    MeshData build();
+    MeshData build_section(size_t);
+
+    template <typename V>
+    MeshData build(const V& volume);
+    MeshData build(const Heightmap&, size_t y_size, size_t border_size);
 private:
+    static constexpr int unmergeable_face = 1;
+    static constexpr int uniform_face = 2;
+    static constexpr int constant_along_u = 3;
+    static constexpr int constant_along_v = 4;
+    static constexpr int merge_kind_shift = 16;
+    static constexpr int merge_kind_mask = 0x7;
+    static constexpr int merge_material_shift = 19;
+
+    const Mode mode;
+
+    // Scratch memory, kept along with its capacity from build to build. A
+    // builder is only used by one thread at a time, so each worker reuses
+    // its own.
+    //
+    // The mesh being built, copied out at its final size.
     MeshData mesh_data;
-    std::map<glm::vec3, GLubyte, Vec3Comparator> vertices_with_brightness;
+    SolidMasks solid_masks;
+    // Material of the voxel at a volume index, only asked for voxels that
+    // have visible faces.
+    std::function<Voxel(glm::ivec3)> material_at;
+    VertexIndexTable vertex_indices;
+    // Brightness of every vertex of the volume, indexed by its position and
+    // computed the first time a face uses it. Zero marks vertices that have
+    // not been computed yet. Brightness only depends on the loaded volume,
+    // so the sections built from it share these.
+    std::vector<uint8_t> vertex_brightnesses;
+    glm::ivec3 vertex_grid_size;
+    std::vector<int> greedy_mask;
+
+    // Ranges of volume rows to be meshed that may have visible faces,
+    // neither adjacent nor overlapping.
+    std::vector<std::pair<size_t, size_t>> mixed_rows;
 
-    void non_empty_voxel(const Volume<Voxel>&, glm::ivec3, glm::vec3);
-    void vertex(const Volume<Voxel>&, glm::ivec3);
+    void reset_brightnesses();
+    MeshData build_rows(size_t begin_y, size_t end_y);
+    size_t count_faces() const;
+    void per_face_faces();
+    void visible_faces(const uint64_t (&)[6], int, glm::ivec3);
+    void greedy_faces();
+    void merge_faces(int normal_index, glm::ivec3 begin, glm::ivec3 end);
+    int face_merge_key(glm::ivec3, int, int, Voxel);
+    void quad(glm::ivec3, glm::ivec3, int, Voxel);
+    uint8_t brightness_at(glm::ivec3);
+    uint8_t vertex_brightness(glm::ivec3) const;
 
-    static const std::vector<std::pair<glm::ivec3, std::vector<glm::vec3>>>
+    // In the order of the normal indices of Vertices::normals.
+    static const std::vector<std::pair<glm::ivec3, std::vector<glm::ivec3>>>
         neighbor_dirs_with_face_vertex_positions;
 };
 
-// The border voxels are considered neighbors and are not included in the mesh.
-MeshData MeshBuilder::build(const Volume<Voxel> volume)
+void MeshBuilder::load(const Volume<Voxel>& volume)
+{
+    solid_masks.load(volume);
+    reset_brightnesses();
+    material_at = [&](glm::ivec3 v) { return volume.at(v); };
+}
+
+void MeshBuilder::load(const BitVolume& volume)
+{
+    solid_masks.load(volume);
+    reset_brightnesses();
+    material_at = [&](glm::ivec3 v) { return volume.at(v); };
+}
+
+void MeshBuilder::load(const PaletteVolume<Voxel>& volume)
+{
+    solid_masks.load(volume);
+    reset_brightnesses();
+    material_at = [&](glm::ivec3 v) { return volume.at(v); };
+}
+
+void MeshBuilder::load(const ColumnVolume& volume)
+{
+    solid_masks.load(volume);
+    reset_brightnesses();
+    material_at = [&](glm::ivec3 v) { return volume.at(v); };
+}
+
+void MeshBuilder::load(const SectionedVolume& volume)
+{
+    solid_masks.load(volume);
+    reset_brightnesses();
+    material_at = [&](glm::ivec3 v) { return volume.at(v); };
+}
+
+// Only the voxels of the center chunk can have faces.
+void MeshBuilder::load(const ChunkNeighborhood& neighborhood)
+{
+    solid_masks.load(neighborhood);
+    reset_brightnesses();
+    const SectionedVolume& center = neighborhood.center();
+    material_at = [&center](glm::ivec3 v) {
+        return center.at(v - glm::ivec3(1, 1, 1));
+    };
+}
+
+void MeshBuilder::load(
+        const Heightmap& heightmap,
+        const size_t y_size,
+        const size_t border_size)
+{
+    solid_masks.load(heightmap, y_size, border_size);
+    reset_brightnesses();
+    material_at = [&heightmap, border_size](glm::ivec3 v) {
+        return terrain_voxel(border_size + heightmap.at(v.x, v.z), v.y);
+    };
+}
+
+void MeshBuilder::reset_brightnesses()
+{
+    vertex_grid_size = glm::ivec3(
+            solid_masks.size_x() - 1,
+            solid_masks.size_y() - 1,
+            solid_masks.size_z() - 1);
+    vertex_brightnesses.assign(
+            vertex_grid_size.x * vertex_grid_size.y * vertex_grid_size.z, 0);
+}
+
+MeshData MeshBuilder::build()
+{
+    return build_rows(1, solid_masks.size_y() - 1);
+}
+
+MeshData MeshBuilder::build_section(const size_t i)
+{
+    return build_rows(
+            solid_masks.section_begin_y(i), solid_masks.section_end_y(i));
+}
+
+template <typename V>
+MeshData MeshBuilder::build(const V& volume)
+{
+    load(volume);
+    return build();
+}
+
+MeshData MeshBuilder::build(
+        const Heightmap& heightmap,
+        const size_t y_size,
+        const size_t border_size)
+{
+    load(heightmap, y_size, border_size);
+    return build();
+}
+
+MeshData MeshBuilder::build_rows(const size_t begin_y, const size_t end_y)
+{
+    mixed_rows.clear();
+    for (size_t i = 0; i < solid_masks.section_count(); ++i) {
+        const size_t section_begin_y =
+            std::max(begin_y, solid_masks.section_begin_y(i));
+        const size_t section_end_y =
+            std::min(end_y, solid_masks.section_end_y(i));
+        if (section_begin_y >= section_end_y
+                || solid_masks.section_uniformity(i)
+                    != SolidMasks::Uniformity::mixed) {
+            continue;
+        }
+        if (!mixed_rows.empty()
+                && mixed_rows.back().second == section_begin_y) {
+            mixed_rows.back().second = section_end_y;
+        } else {
+            mixed_rows.push_back({section_begin_y, section_end_y});
+        }
+    }
+
+    // Every face becomes at most one quad of four vertices.
+    const size_t face_count = count_faces();
+    mesh_data.vertices.clear();
+    mesh_data.indices.clear();
+    mesh_data.vertices.reserve(4 * face_count);
+    mesh_data.indices.reserve(6 * face_count);
+    vertex_indices.clear();
+
+    if (mode == Mode::greedy) {
+        greedy_faces();
+    } else {
+        per_face_faces();
+    }
+
+    MeshData built;
+    built.vertices = mesh_data.vertices;
+    if (mesh_data.vertices.size() <= std::numeric_limits<uint16_t>::max() + 1) {
+        built.short_indices.assign(
+                mesh_data.indices.begin(), mesh_data.indices.end());
+    } else {
+        built.indices = mesh_data.indices;
+    }
+    return built;
+}
+
+// Visible faces of the rows to be meshed.
+size_t MeshBuilder::count_faces() const
+{
+    size_t count = 0;
+    for (size_t z = 1; z < solid_masks.size_z() - 1; ++z) {
+        for (const auto& rows : mixed_rows) {
+            for (size_t y = rows.first; y < rows.second; ++y) {
+                uint64_t faces[6];
+                solid_masks.visible_faces(y, z, faces);
+                for (const uint64_t f : faces) {
+                    count += __builtin_popcountll(f);
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// Finds the visible faces a whole row at a time and walks only the voxels
+// that have at least one of them, in the same order as a voxel by voxel
+// scan would.
+void MeshBuilder::per_face_faces()
 {
-    mesh_data = {};
-    vertices_with_brightness = {};
+    for (size_t z = 1; z < solid_masks.size_z() - 1; ++z) {
+        for (const auto& rows : mixed_rows) {
+            for (size_t y = rows.first; y < rows.second; ++y) {
+                uint64_t faces[6];
+                solid_masks.visible_faces(y, z, faces);
+
+                uint64_t voxels_with_faces = faces[0] | faces[1] | faces[2]
+                    | faces[3] | faces[4] | faces[5];
+                while (voxels_with_faces != 0) {
+                    const int bit = __builtin_ctzll(voxels_with_faces);
+                    voxels_with_faces &= voxels_with_faces - 1;
+
+                    const glm::ivec3 current_pos(bit, y - 1, z - 1);
+                    visible_faces(faces, bit, current_pos);
+                }
+            }
+        }
+    }
+}
 
-    volume.for_each_voxel_in_border(1, 1, 1, [&](auto x, auto y, auto z) {
-        const glm::ivec3 current_idx(x, y, z);
-        const glm::vec3 current_pos(x - 1 , y - 1, z - 1);
-        const Voxel current = volume.at(current_idx);
+void MeshBuilder::visible_faces(
+        const uint64_t (&faces)[6], const int bit, const glm::ivec3 current_pos)
+{
+    const Voxel material = material_at(current_pos + glm::ivec3(1, 1, 1));
+    for (int i = 0; i < 6; ++i) {
+        if (faces[i] >> bit & 1) {
+            quad(current_pos, glm::ivec3(1, 1, 1), i, material);
+        }
+    }
+}
+
+// Collects the exposed faces of each direction into a 2D mask per slice of
+// the volume, then covers every slice's mask with as few rectangles as
+// possible. Faces are only merged along directions in which their corner
+// brightnesses are constant, so the interpolated ambient occlusion looks
+// exactly as before.
+void MeshBuilder::greedy_faces()
+{
+    const glm::ivec3 size(
+            solid_masks.size_x() - 2,
+            solid_masks.size_y() - 2,
+            solid_masks.size_z() - 2);
+
+    // Merging clears every face it covers, so the mask is all zero again
+    // after each direction.
+    greedy_mask.resize(size.x * size.y * size.z);
+    assert(std::all_of(greedy_mask.begin(), greedy_mask.end(),
+            [](int key) { return key == 0; }));
+
+    for (int normal_index = 0; normal_index < 6; ++normal_index) {
+        const auto& neighbor =
+            neighbor_dirs_with_face_vertex_positions[normal_index];
+        const glm::ivec3 dir = neighbor.first;
+        const int n = dir.x != 0 ? 0 : dir.y != 0 ? 1 : 2;
+        const int u = (n + 1) % 3;
+        const int v = (n + 2) % 3;
+        const int slice_area = size[u] * size[v];
+
+        // Only the voxels with a visible face are visited, a row at a time.
+        for (int z = 0; z < size.z; ++z) {
+            for (const auto& rows : mixed_rows) {
+                for (size_t y = rows.first; y < rows.second; ++y) {
+                    uint64_t faces[6];
+                    solid_masks.visible_faces(y, z + 1, faces);
+
+                    uint64_t voxels_with_face = faces[normal_index];
+                    while (voxels_with_face != 0) {
+                        const int x = __builtin_ctzll(voxels_with_face);
+                        voxels_with_face &= voxels_with_face - 1;
+
+                        const glm::ivec3 pos(x, y - 1, z);
+                        glm::ivec3 face_origin = pos;
+                        face_origin[n] += neighbor.second.front()[n];
+                        greedy_mask[pos[n] * slice_area + pos[v] * size[u]
+                            + pos[u]] = face_merge_key(face_origin, u, v,
+                                    material_at(pos + glm::ivec3(1, 1, 1)));
+                    }
+                }
+            }
+        }
 
-        if (current != Voxel::empty) {
-            this->non_empty_voxel(volume, current_idx, current_pos);
+        // No face lies between the mixed row ranges, so none can be merged
+        // across them either.
+        for (const auto& rows : mixed_rows) {
+            merge_faces(
+                    normal_index,
+                    glm::ivec3(0, rows.first - 1, 0),
+                    glm::ivec3(size.x, rows.second - 1, size.z));
         }
-    });
+    }
+}
+
+// Covers the faces of the mask within the box of interior positions from
+// begin to end.
+void MeshBuilder::merge_faces(
+        const int normal_index, const glm::ivec3 begin, const glm::ivec3 end)
+{
+    const glm::ivec3 size(
+            solid_masks.size_x() - 2,
+            solid_masks.size_y() - 2,
+            solid_masks.size_z() - 2);
+    const glm::ivec3 dir =
+        neighbor_dirs_with_face_vertex_positions[normal_index].first;
+    const int n = dir.x != 0 ? 0 : dir.y != 0 ? 1 : 2;
+    const int u = (n + 1) % 3;
+    const int v = (n + 2) % 3;
+    const int slice_area = size[u] * size[v];
 
-    volume.for_each_vertex_in_border(1, 1, 1, [&](auto x, auto y, auto z) {
-        const glm::ivec3 current_idx(x, y, z);
-        this->vertex(volume, current_idx);
-    });
+    for (int slice = begin[n]; slice < end[n]; ++slice) {
+        const auto slice_mask = greedy_mask.begin() + slice * slice_area;
 
-    std::transform(
-            mesh_data.positions.begin(),
-            mesh_data.positions.end(),
-            std::back_inserter(mesh_data.brightnesses),
-            [&](auto v) {
-                assert(vertices_with_brightness.count(v) == 1);
+        for (int iv = begin[v]; iv < end[v]; ++iv) {
+            for (int iu = begin[u]; iu < end[u]; ) {
+                const int key = slice_mask[iv * size[u] + iu];
+                if (key == 0) {
+                    ++iu;
+                    continue;
+                }
 
-                return vertices_with_brightness[v];
-            });
+                const int kind = key >> merge_kind_shift & merge_kind_mask;
+                int width = 1;
+                int height = 1;
+                if (kind == uniform_face || kind == constant_along_u) {
+                    while (iu + width < end[u]
+                            && slice_mask[iv * size[u] + iu + width] == key) {
+                        ++width;
+                    }
+                }
+                if (kind == uniform_face || kind == constant_along_v) {
+                    bool row_matches = true;
+                    while (row_matches && iv + height < end[v]) {
+                        const auto row =
+                            slice_mask + (iv + height) * size[u] + iu;
+                        row_matches = std::all_of(row, row + width,
+                                [=](int k) { return k == key; });
+                        if (row_matches) {
+                            ++height;
+                        }
+                    }
+                }
 
-    return mesh_data;
+                for (int dv = 0; dv < height; ++dv) {
+                    const auto row = slice_mask + (iv + dv) * size[u] + iu;
+                    std::fill(row, row + width, 0);
+                }
+
+                glm::ivec3 pos;
+                pos[n] = slice;
+                pos[u] = iu;
+                pos[v] = iv;
+                glm::ivec3 extent(1, 1, 1);
+                extent[u] = width;
+                extent[v] = height;
+                const Voxel material = (Voxel) (key >> merge_material_shift);
+                quad(pos, extent, normal_index, material);
+
+                iu += width;
+            }
+        }
+    }
 }
 
-void MeshBuilder::non_empty_voxel(
-        const Volume<Voxel> &volume,
-        const glm::ivec3 current_idx,
-        const glm::vec3 current_pos)
+// Faces can only be merged without changing the interpolated brightness if
+// it does not vary along the direction of merging. The key encodes the
+// material, the direction(s) a face can be merged in and the corner
+// brightnesses that the neighboring faces have to match. Zero is left free
+// for "no face".
+int MeshBuilder::face_merge_key(
+        const glm::ivec3 face_origin,
+        const int u,
+        const int v,
+        const Voxel material)
 {
-    for (auto neighbor : neighbor_dirs_with_face_vertex_positions) {
-        const auto neighbor_idx = current_idx + neighbor.first;
+    uint8_t corners[2][2];
+    for (int du = 0; du <= 1; ++du) {
+        for (int dv = 0; dv <= 1; ++dv) {
+            glm::ivec3 corner = face_origin;
+            corner[u] += du;
+            corner[v] += dv;
+            corners[du][dv] = brightness_at(corner);
+        }
+    }
 
-        if (volume.at(neighbor_idx) == Voxel::empty) {
-            auto &rel_positions = neighbor.second;
-            const glm::vec3 normal(
-                    neighbor.first.x, neighbor.first.y, neighbor.first.z);
+    const bool along_u = corners[0][0] == corners[1][0]
+        && corners[0][1] == corners[1][1];
+    const bool along_v = corners[0][0] == corners[0][1]
+        && corners[1][0] == corners[1][1];
 
-            std::transform(
-                    rel_positions.begin(),
-                    rel_positions.end(),
-                    std::back_inserter(mesh_data.positions),
-                    [=](auto rel_pos) { return current_pos + rel_pos; });
-            mesh_data.normals.insert(mesh_data.normals.end(), 6, normal);
+    int key = (int) material << merge_material_shift;
+    if (along_u && along_v) {
+        key |= uniform_face << merge_kind_shift | corners[0][0];
+    } else if (along_u) {
+        key |= constant_along_u << merge_kind_shift
+            | corners[0][0] << 8 | corners[0][1];
+    } else if (along_v) {
+        key |= constant_along_v << merge_kind_shift
+            | corners[0][0] << 8 | corners[1][0];
+    } else {
+        key |= unmergeable_face << merge_kind_shift;
+    }
+    return key;
+}
+
+// Emits the unit face facing the given normal, stretched by extent along
+// the face's plane. Its vertices are shared with the faces emitted before
+// that have the same position, normal, brightness and material at their
+// corners.
+void MeshBuilder::quad(
+        const glm::ivec3 pos,
+        const glm::ivec3 extent,
+        const int normal_index,
+        const Voxel material)
+{
+    const auto& rel_positions =
+        neighbor_dirs_with_face_vertex_positions[normal_index].second;
+
+    for (const auto rel_pos : rel_positions) {
+        const glm::ivec3 vertex = pos + rel_pos * extent;
+        const PackedVertex packed = Vertices::pack(
+                vertex, normal_index, brightness_at(vertex), material);
+
+        const auto index =
+            vertex_indices.insert(packed, mesh_data.vertices.size());
+        if (index.second) {
+            mesh_data.vertices.push_back(packed);
         }
+        mesh_data.indices.push_back(index.first);
+    }
+}
+
+uint8_t MeshBuilder::brightness_at(const glm::ivec3 vertex)
+{
+    const int x = vertex.x;
+    const int y = vertex.y;
+    const int z = vertex.z;
+
+    assert(x >= 0 && x < vertex_grid_size.x);
+    assert(y >= 0 && y < vertex_grid_size.y);
+    assert(z >= 0 && z < vertex_grid_size.z);
+
+    uint8_t& brightness = vertex_brightnesses[
+        (z * vertex_grid_size.y + y) * vertex_grid_size.x + x];
+    if (brightness == 0) {
+        brightness = vertex_brightness(glm::ivec3(x + 1, y + 1, z + 1));
     }
+    return brightness;
 }
 
-void MeshBuilder::vertex(
-        const Volume<Voxel> &volume, const glm::ivec3 current_idx)
+uint8_t MeshBuilder::vertex_brightness(const glm::ivec3 current_idx) const
 {
-    const glm::vec3 vertex(
-            current_idx.x - 1, current_idx.y - 1, current_idx.z - 1);
-    GLubyte nonempty_neighbor_voxel_count = 0;
+    uint8_t nonempty_neighbor_voxel_count = 0;
 
     for (int dz = -1; dz <= 0; ++dz) {
         for (int dy = -1; dy <= 0; ++dy) {
@@ -108,82 +532,82 @@ void MeshBuilder::vertex(
                         current_idx.x + dx,
                         current_idx.y + dy,
                         current_idx.z + dz);
-                const Voxel neighbor = volume.at(neighbor_voxel_pos);
 
-                if (neighbor != Voxel::empty) {
+                if (solid_masks.solid(neighbor_voxel_pos)) {
                     ++nonempty_neighbor_voxel_count;
                 }
             }
         }
     }
 
-    if (nonempty_neighbor_voxel_count > 0
-            && nonempty_neighbor_voxel_count < 8) {
-        // Mapping values from 0 (dark) to 255 (bright).
-        GLubyte brightness = (8 - nonempty_neighbor_voxel_count) << 5;
-        vertices_with_brightness[vertex] = brightness;
-    }
+    // Vertices of visible faces always have both empty and non-empty
+    // neighbors.
+    assert(nonempty_neighbor_voxel_count > 0
+            && nonempty_neighbor_voxel_count < 8);
+
+    // Mapping values from 0 (dark) to 255 (bright).
+    return (8 - nonempty_neighbor_voxel_count) << 5;
 }
 
-const std::vector<std::pair<glm::ivec3, std::vector<glm::vec3>>>
+const std::vector<std::pair<glm::ivec3, std::vector<glm::ivec3>>>
     MeshBuilder::neighbor_dirs_with_face_vertex_positions = {
     // Left face
     { glm::ivec3(-1, 0, 0),
         {
-            glm::vec3(0, 0, 0),
-            glm::vec3(0, 0, 1),
-            glm::vec3(0, 1, 0),
-            glm::vec3(0, 0, 1),
-            glm::vec3(0, 1, 1),
-            glm::vec3(0, 1, 0),
+            glm::ivec3(0, 0, 0),
+            glm::ivec3(0, 0, 1),
+            glm::ivec3(0, 1, 0),
+            glm::ivec3(0, 0, 1),
+            glm::ivec3(0, 1, 1),
+            glm::ivec3(0, 1, 0),
         }
     },
 
     // Right face
     { glm::ivec3(1, 0, 0),
         {
-            glm::vec3(1, 0, 0),
-            glm::vec3(1, 1, 0),
-            glm::vec3(1, 0, 1),
-            glm::vec3(1, 0, 1),
-            glm::vec3(1, 1, 0),
-            glm::vec3(1, 1, 1),
+            glm::ivec3(1, 0, 0),
+            glm::ivec3(1, 1, 0),
+            glm::ivec3(1, 0, 1),
+            glm::ivec3(1, 0, 1),
+            glm::ivec3(1, 1, 0),
+            glm::ivec3(1, 1, 1),
         }
     },
 
     // Bottom face
     { glm::ivec3(0, -1, 0),
         {
-            glm::vec3(0, 0, 0),
-            glm::vec3(1, 0, 0),
-            glm::vec3(0, 0, 1),
-            glm::vec3(1, 0, 0),
-            glm::vec3(1, 0, 1),
-            glm::vec3(0, 0, 1),
+            glm::ivec3(0, 0, 0),
+            glm::ivec3(1, 0, 0),
+            glm::ivec3(0, 0, 1),
+            glm::ivec3(1, 0, 0),
+            glm::ivec3(1, 0, 1),
+            glm::ivec3(0, 0, 1),
         }
     },
 
     // Top face
     { glm::ivec3(0, 1, 0),
         {
-            glm::vec3(0, 1, 0),
-            glm::vec3(0, 1, 1),
-            glm::vec3(1, 1, 0),
-            glm::vec3(1, 1, 0),
-            glm::vec3(0, 1, 1),
-            glm::vec3(1, 1, 1),
+            glm::ivec3(0, 1, 0),
+            glm::ivec3(0, 1, 1),
+            glm::ivec3(1, 1, 0),
+            glm::ivec3(1, 1, 0),
+            glm::ivec3(0, 1, 1),
+            glm::ivec3(1, 1, 1),
         }
     },
 
     // Back face
     { glm::ivec3(0, 0, -1),
         {
-            glm::vec3(0, 0, 0),
-            glm::vec3(0, 1, 0),
-            glm::vec3(1, 0, 0),
-            glm::vec3(0, 1, 0),
-            glm::vec3(1, 1, 0),
-            glm::vec3(1, 0, 0),
+            glm::ivec3(0, 0, 0),
+            glm::ivec3(0, 1, 0),
+            glm::ivec3(1, 0, 0),
+            glm::ivec3(0, 1, 0),
+            glm::ivec3(1, 1, 0),
+            glm::ivec3(1, 0, 0),
         }
     },
 
@@ -191,12 +615,12 @@ const std::vector<std::pair<glm::ivec3, std::vector<glm::vec3>>>
     // Front face
     { glm::ivec3(0, 0, 1),
         {
-            glm::vec3(0, 0, 1),
-            glm::vec3(1, 0, 1),
-            glm::vec3(0, 1, 1),
-            glm::vec3(0, 1, 1),
-            glm::vec3(1, 0, 1),
-            glm::vec3(1, 1, 1),
+            glm::ivec3(0, 0, 1),
+            glm::ivec3(1, 0, 1),
+            glm::ivec3(0, 1, 1),
+            glm::ivec3(0, 1, 1),
+            glm::ivec3(1, 0, 1),
+            glm::ivec3(1, 1, 1),
         }
     },
 };
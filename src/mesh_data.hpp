@@ -0,0 +1,16 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct MeshData
+{
+    std::vector<PackedVertex> vertices;
+
+    // Triangles as indices into vertices. Only one of these is filled: the
+    // 16-bit indices whenever there are few enough vertices for them.
+    std::vector<uint16_t> short_indices;
+    std::vector<uint32_t> indices;
+};
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Counters and timing histograms of what the program spends its time on.
+// Recording is a few relaxed atomic operations, so they stay enabled in
+// release builds, and they can be recorded from any thread.
+//
+// Summaries cover the time since the previous summary. While tracing, every
+// timed scope is kept as an event as well, to be exported in the Chrome
+// trace event format for chrome://tracing or Perfetto.
+namespace Metrics
+{
+
+typedef std::chrono::steady_clock Clock;
+
+enum class Counter
+{
+    chunks_sampled,
+    chunks_meshed,
+    mesh_cache_hits,
+    mesh_cache_misses,
+    mesh_cache_evictions,
+    vertices_drawn,
+    gl_upload_bytes,
+    // Per frame, of the chunks within the view radius.
+    chunks_visible,
+    chunks_culled,
+    count
+};
+
+enum class Timer
+{
+    frame,
+    draw,
+    update_meshes,
+    upload_mesh,
+    build_mesh,
+    sample_volume,
+    sample_heightmap,
+    count
+};
+
+void add(Counter, uint64_t amount = 1);
+void record(Timer, Clock::time_point begin, Clock::time_point end);
+
+// Records the time from its construction to its destruction.
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Timer t) : timer(t), begin(Clock::now()) {}
+    ~ScopedTimer() { record(timer, begin, Clock::now()); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+private:
+    const Timer timer;
+    const Clock::time_point begin;
+};
+
+// Writes the counters and the timer percentiles recorded since the last
+// summary, and starts counting anew.
+void write_summary(std::ostream&);
+
+void start_trace();
+// Writes the events traced since start_trace as Chrome trace event JSON and
+// stops tracing. At most max_trace_events are kept, later ones are dropped.
+void write_trace(std::ostream&);
+
+constexpr size_t max_trace_events = 1 << 20;
+
+// Timer histograms have four buckets per power of two nanoseconds, so a
+// percentile is off by at most an eighth of its value.
+constexpr int sub_bucket_bits = 2;
+constexpr int bucket_count = 64 << sub_bucket_bits;
+
+struct Histogram
+{
+    std::array<std::atomic<uint64_t>, bucket_count> buckets;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+};
+
+struct TraceEvent
+{
+    Timer timer;
+    int thread;
+    Clock::time_point begin;
+    Clock::time_point end;
+};
+
+struct State
+{
+    std::array<std::atomic<uint64_t>, size_t(Counter::count)> counters;
+    std::array<Histogram, size_t(Timer::count)> histograms;
+    std::atomic<Clock::rep> period_begin;
+
+    std::atomic<bool> tracing;
+    std::mutex trace_mutex;
+    Clock::time_point trace_begin;
+    std::vector<TraceEvent> trace_events;
+};
+
+State& state();
+int bucket_of(uint64_t ns);
+uint64_t bucket_middle_ns(int bucket);
+uint64_t percentile_ns(const std::array<uint64_t, bucket_count>&,
+        uint64_t count, double fraction);
+int thread_number();
+const char* name(Counter);
+const char* name(Timer);
+
+void add(const Counter counter, const uint64_t amount)
+{
+    state().counters[size_t(counter)].fetch_add(
+            amount, std::memory_order_relaxed);
+}
+
+void record(
+        const Timer timer,
+        const Clock::time_point begin,
+        const Clock::time_point end)
+{
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            end - begin).count();
+    Histogram& histogram = state().histograms[size_t(timer)];
+    histogram.buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    histogram.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max_ns = histogram.max_ns.load(std::memory_order_relaxed);
+    while (ns > max_ns && !histogram.max_ns.compare_exchange_weak(
+                max_ns, ns, std::memory_order_relaxed)) {}
+
+    if (state().tracing.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(state().trace_mutex);
+        if (state().trace_events.size() < max_trace_events) {
+            state().trace_events.push_back(
+                    {timer, thread_number(), begin, end});
+        }
+    }
+}
+
+// Counters and histograms are read and cleared one by one, so a value
+// recorded meanwhile lands in either this summary or the next one.
+void write_summary(std::ostream& os)
+{
+    const Clock::rep now = Clock::now().time_since_epoch().count();
+    const Clock::rep begin = state().period_begin.exchange(now);
+    const double seconds = begin == 0 ? 0 : std::chrono::duration<double>(
+            Clock::duration(now - begin)).count();
+
+    os << "Metrics";
+    if (seconds > 0) {
+        os << " over the last " << std::fixed << std::setprecision(1)
+            << seconds << " s";
+    }
+    os << ":\n";
+
+    for (size_t i = 0; i < size_t(Counter::count); ++i) {
+        const uint64_t value = state().counters[i].exchange(0);
+        os << "  " << std::left << std::setw(24) << name(Counter(i))
+            << std::right << std::setw(12) << value;
+        if (seconds > 0) {
+            os << std::fixed << std::setprecision(1) << std::setw(14)
+                << value / seconds << "/s";
+        }
+        os << '\n';
+    }
+
+    const auto ms = [](uint64_t ns) { return ns / 1e6; };
+    for (size_t i = 0; i < size_t(Timer::count); ++i) {
+        Histogram& histogram = state().histograms[i];
+        std::array<uint64_t, bucket_count> buckets;
+        uint64_t count = 0;
+        for (int b = 0; b < bucket_count; ++b) {
+            buckets[b] = histogram.buckets[b].exchange(0);
+            count += buckets[b];
+        }
+        const uint64_t total_ns = histogram.total_ns.exchange(0);
+        const uint64_t max_ns = histogram.max_ns.exchange(0);
+
+        os << "  " << std::left << std::setw(24) << name(Timer(i))
+            << std::right << std::setw(12) << count;
+        if (count > 0) {
+            os << std::fixed << std::setprecision(3)
+                << "  mean " << ms(total_ns / count)
+                << "  p50 " << ms(percentile_ns(buckets, count, 0.5))
+                << "  p90 " << ms(percentile_ns(buckets, count, 0.9))
+                << "  p99 " << ms(percentile_ns(buckets, count, 0.99))
+                << "  max " << ms(max_ns) << " ms";
+        }
+        os << '\n';
+    }
+    os << std::flush;
+}
+
+void start_trace()
+{
+    std::lock_guard<std::mutex> lock(state().trace_mutex);
+    state().trace_events.clear();
+    state().trace_begin = Clock::now();
+    state().tracing = true;
+}
+
+// Complete events ("ph": "X") with timestamps in microseconds.
+void write_trace(std::ostream& os)
+{
+    std::lock_guard<std::mutex> lock(state().trace_mutex);
+    state().tracing = false;
+
+    const auto us = [](Clock::duration d) {
+        return std::chrono::duration<double, std::micro>(d).count();
+    };
+    os << "{\"traceEvents\": [\n" << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < state().trace_events.size(); ++i) {
+        const TraceEvent& event = state().trace_events[i];
+        os << (i == 0 ? "" : ",\n")
+            << "{\"name\": \"" << name(event.timer) << "\", "
+            << "\"ph\": \"X\", "
+            << "\"ts\": " << us(event.begin - state().trace_begin) << ", "
+            << "\"dur\": " << us(event.end - event.begin) << ", "
+            << "\"pid\": 1, \"tid\": " << event.thread << "}";
+    }
+    os << "\n], \"displayTimeUnit\": \"ms\"}\n";
+    state().trace_events.clear();
+}
+
+State& state()
+{
+    static State state {};
+    return state;
+}
+
+int bucket_of(const uint64_t ns)
+{
+    if (ns < (uint64_t(1) << sub_bucket_bits)) {
+        return int(ns);
+    }
+    const int msb = 63 - __builtin_clzll(ns);
+    const int sub_bucket = int(ns >> (msb - sub_bucket_bits))
+        & ((1 << sub_bucket_bits) - 1);
+    return (msb - sub_bucket_bits + 1) << sub_bucket_bits | sub_bucket;
+}
+
+uint64_t bucket_middle_ns(const int bucket)
+{
+    const int octave = bucket >> sub_bucket_bits;
+    if (octave == 0) {
+        return bucket;
+    }
+    const int sub_bucket = bucket & ((1 << sub_bucket_bits) - 1);
+    const int shift = octave - 1;
+    const uint64_t low =
+        uint64_t((1 << sub_bucket_bits) | sub_bucket) << shift;
+    return low + (uint64_t(1) << shift) / 2;
+}
+
+uint64_t percentile_ns(
+        const std::array<uint64_t, bucket_count>& buckets,
+        const uint64_t count,
+        const double fraction)
+{
+    const uint64_t rank = uint64_t(fraction * (count - 1));
+    uint64_t seen = 0;
+    for (int b = 0; b < bucket_count; ++b) {
+        seen += buckets[b];
+        if (seen > rank) {
+            return bucket_middle_ns(b);
+        }
+    }
+    return 0;
+}
+
+// Small and stable numbers for the trace, in the order threads first
+// record something.
+int thread_number()
+{
+    static std::atomic<int> next_number(1);
+    thread_local const int number = next_number++;
+    return number;
+}
+
+const char* name(const Counter counter)
+{
+    static const char* const names[] = {
+        "chunks_sampled",
+        "chunks_meshed",
+        "mesh_cache_hits",
+        "mesh_cache_misses",
+        "mesh_cache_evictions",
+        "vertices_drawn",
+        "gl_upload_bytes",
+        "chunks_visible",
+        "chunks_culled",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == size_t(Counter::count),
+            "every counter has a name");
+    return names[size_t(counter)];
+}
+
+const char* name(const Timer timer)
+{
+    static const char* const names[] = {
+        "frame",
+        "draw",
+        "update_meshes",
+        "upload_mesh",
+        "build_mesh",
+        "sample_volume",
+        "sample_heightmap",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == size_t(Timer::count),
+            "every timer has a name");
+    return names[size_t(timer)];
+}
+
+}
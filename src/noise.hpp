@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Seeded gradient noise in 2D and 3D, plus fractal sums of several octaves
+// of it. Gradients are picked by hashing the lattice coordinates with the
+// seed rather than through a permutation table, so there is no state to
+// share between threads. The same seed and coordinates give the same value
+// on every thread.
+class Noise
+{
+public:
+    explicit Noise(uint32_t s) : seed(s) {}
+
+    // Roughly within [-1, 1], zero at every lattice point.
+    float at(float x, float z) const;
+    float at(float x, float y, float z) const;
+
+    // Sums octaves of noise, each at twice the frequency and half the
+    // amplitude of the one before, scaled back to roughly [-1, 1]. Octaves
+    // are seeded differently so that their lattices do not line up.
+    float fractal(float x, float z, int octaves) const;
+    float fractal(float x, float y, float z, int octaves) const;
+    // The same as fractal(xs[i], z, octaves) into out[i] for each of the
+    // count samples, a whole row at a time: what depends only on z and the
+    // octave is done once per row rather than once per sample.
+    void fractal_row(
+            const float* xs, size_t count, float z, int octaves,
+            float* out) const;
+private:
+    uint32_t seed;
+
+    static uint32_t hash(uint32_t seed, int x, int y, int z);
+    static float fade(float t);
+    static float lerp(float a, float b, float t) { return a + t * (b - a); }
+    static float gradient(uint32_t hash, float x, float z);
+    static float gradient(uint32_t hash, float x, float y, float z);
+
+    // Gradient components, indexed by the low bits of a lattice hash.
+    static const float gradients_2d[8][2];
+    static const float gradients_3d[16][3];
+};
+
+// The axes and the diagonals.
+const float Noise::gradients_2d[8][2] = {
+    { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 },
+    { 0.7071f, 0.7071f }, { 0.7071f, -0.7071f },
+    { -0.7071f, 0.7071f }, { -0.7071f, -0.7071f },
+};
+
+// The twelve edge directions of a cube, four of which are repeated to make
+// sixteen.
+const float Noise::gradients_3d[16][3] = {
+    { 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+    { 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+    { 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 },
+    { 1, 1, 0 }, { 1, -1, 0 }, { -1, 1, 0 }, { 0, -1, -1 },
+};
+
+float Noise::at(const float x, const float z) const
+{
+    const float fx = std::floor(x);
+    const float fz = std::floor(z);
+    const int ix = int(fx);
+    const int iz = int(fz);
+    const float tx = x - fx;
+    const float tz = z - fz;
+
+    const float n00 = gradient(hash(seed, ix, 0, iz), tx, tz);
+    const float n10 = gradient(hash(seed, ix + 1, 0, iz), tx - 1, tz);
+    const float n01 = gradient(hash(seed, ix, 0, iz + 1), tx, tz - 1);
+    const float n11 = gradient(hash(seed, ix + 1, 0, iz + 1), tx - 1, tz - 1);
+
+    const float u = fade(tx);
+    return lerp(lerp(n00, n10, u), lerp(n01, n11, u), fade(tz));
+}
+
+float Noise::at(const float x, const float y, const float z) const
+{
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const float fz = std::floor(z);
+    const int ix = int(fx);
+    const int iy = int(fy);
+    const int iz = int(fz);
+    const float tx = x - fx;
+    const float ty = y - fy;
+    const float tz = z - fz;
+
+    float layers[2];
+    for (int dz = 0; dz <= 1; ++dz) {
+        float edges[2];
+        for (int dy = 0; dy <= 1; ++dy) {
+            const float n0 = gradient(
+                    hash(seed, ix, iy + dy, iz + dz), tx, ty - dy, tz - dz);
+            const float n1 = gradient(
+                    hash(seed, ix + 1, iy + dy, iz + dz),
+                    tx - 1, ty - dy, tz - dz);
+            edges[dy] = lerp(n0, n1, fade(tx));
+        }
+        layers[dz] = lerp(edges[0], edges[1], fade(ty));
+    }
+    return lerp(layers[0], layers[1], fade(tz));
+}
+
+float Noise::fractal(const float x, const float z, const int octaves) const
+{
+    float sum = 0;
+    float amplitude = 1;
+    float amplitude_sum = 0;
+    float frequency = 1;
+    for (int i = 0; i < octaves; ++i) {
+        sum += amplitude
+            * Noise(seed + i).at(x * frequency, z * frequency);
+        amplitude_sum += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2;
+    }
+    return sum / amplitude_sum;
+}
+
+float Noise::fractal(
+        const float x, const float y, const float z, const int octaves) const
+{
+    float sum = 0;
+    float amplitude = 1;
+    float amplitude_sum = 0;
+    float frequency = 1;
+    for (int i = 0; i < octaves; ++i) {
+        sum += amplitude * Noise(seed + i).at(
+                x * frequency, y * frequency, z * frequency);
+        amplitude_sum += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2;
+    }
+    return sum / amplitude_sum;
+}
+
+// Octave by octave over the row, in the order fractal() sums them. The
+// lattice row and its fade only depend on z, and the four gradients of a
+// cell are only looked up again when a sample moves into the next cell.
+void Noise::fractal_row(
+        const float* const xs, const size_t count, const float z,
+        const int octaves, float* const out) const
+{
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = 0;
+    }
+
+    float amplitude = 1;
+    float amplitude_sum = 0;
+    float frequency = 1;
+    for (int octave = 0; octave < octaves; ++octave) {
+        const uint32_t octave_seed = seed + octave;
+        const float fz = std::floor(z * frequency);
+        const int iz = int(fz);
+        const float tz = z * frequency - fz;
+        const float v = fade(tz);
+
+        int cell_x = 0;
+        const float* g00 = nullptr;
+        const float* g10 = nullptr;
+        const float* g01 = nullptr;
+        const float* g11 = nullptr;
+        for (size_t i = 0; i < count; ++i) {
+            const float x = xs[i] * frequency;
+            const float fx = std::floor(x);
+            const int ix = int(fx);
+            if (i == 0 || ix != cell_x) {
+                cell_x = ix;
+                g00 = gradients_2d[hash(octave_seed, ix, 0, iz) & 7];
+                g10 = gradients_2d[hash(octave_seed, ix + 1, 0, iz) & 7];
+                g01 = gradients_2d[hash(octave_seed, ix, 0, iz + 1) & 7];
+                g11 = gradients_2d[hash(octave_seed, ix + 1, 0, iz + 1) & 7];
+            }
+            const float tx = x - fx;
+            const float n00 = g00[0] * tx + g00[1] * tz;
+            const float n10 = g10[0] * (tx - 1) + g10[1] * tz;
+            const float n01 = g01[0] * tx + g01[1] * (tz - 1);
+            const float n11 = g11[0] * (tx - 1) + g11[1] * (tz - 1);
+            const float u = fade(tx);
+            out[i] += amplitude
+                * lerp(lerp(n00, n10, u), lerp(n01, n11, u), v);
+        }
+        amplitude_sum += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        out[i] /= amplitude_sum;
+    }
+}
+
+uint32_t Noise::hash(const uint32_t seed, const int x, const int y, const int z)
+{
+    uint32_t h = seed * 0x9E3779B1u;
+    h ^= uint32_t(x) * 0x8DA6B343u;
+    h ^= uint32_t(y) * 0xD8163841u;
+    h ^= uint32_t(z) * 0xCB1AB31Fu;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Smoothstep with zero first and second derivatives at both ends.
+float Noise::fade(const float t)
+{
+    return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+float Noise::gradient(const uint32_t hash, const float x, const float z)
+{
+    const float* const g = gradients_2d[hash & 7];
+    return g[0] * x + g[1] * z;
+}
+
+float Noise::gradient(
+        const uint32_t hash, const float x, const float y, const float z)
+{
+    const float* const g = gradients_3d[hash & 15];
+    return g[0] * x + g[1] * y + g[2] * z;
+}
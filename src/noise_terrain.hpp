@@ -0,0 +1,209 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include "heightmap.hpp"
+#include "noise.hpp"
+#include "volume.hpp"
+#include "volumegen.hpp"
+#include "voxel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Terrain of rolling hills from fractal noise, optionally hollowed out by
+// caves and overhangs from 3D noise. Its samplers are plain functions of
+// the settings and the world coordinates, so a copy can be used from any
+// thread and every thread generates the same terrain.
+//
+// Without caves, the volume is exactly what volume_from_heightmap fills
+// from the heightmap, so chunks can be meshed from heightmaps alone. With
+// them, only volume should be given to the ChunkVolumeRepository.
+class NoiseTerrain
+{
+public:
+    struct Settings
+    {
+        uint32_t seed = 1;
+        int octaves = 5;
+        // Wavelength of the lowest octave of the heights, in voxels.
+        float feature_size = 128;
+        // Average height and how far heights stray from it, as fractions
+        // of the volume height.
+        float mean_height = 0.4f;
+        float height_variation = 0.35f;
+
+        bool caves = false;
+        int cave_octaves = 2;
+        float cave_feature_size = 32;
+        // Voxels whose density noise is above this are hollowed out.
+        float cave_threshold = 0.3f;
+    };
+
+    explicit NoiseTerrain(Settings s) : settings(s) {}
+
+    Heightmap heightmap(
+            glm::ivec3 begin_coord, glm::ivec3 end_coord, int border_size)
+        const;
+    Volume<Voxel> volume(
+            glm::ivec3 begin_coord, glm::ivec3 end_coord, int border_size)
+        const;
+private:
+    // Spacing of the cave density samples, in voxels.
+    static constexpr int cave_lattice_step = 4;
+
+    Settings settings;
+
+    void carve_caves(
+            Volume<Voxel>&, const Heightmap&, glm::ivec3 begin_coord,
+            int border_size) const;
+};
+
+// Each row of noise is evaluated into a buffer first, a whole row at a
+// time, and only then turned into heights.
+Heightmap NoiseTerrain::heightmap(
+        const glm::ivec3 begin_coord,
+        const glm::ivec3 end_coord,
+        const int border_size)
+    const
+{
+    assert(begin_coord.x <= end_coord.x);
+    assert(begin_coord.y < end_coord.y);
+    assert(begin_coord.z <= end_coord.z);
+
+    const int y_size = end_coord.y - begin_coord.y;
+    const float scale = 1 / settings.feature_size;
+    const Noise noise(settings.seed);
+
+    Heightmap heightmap(
+            end_coord.x - begin_coord.x + 2 * border_size,
+            end_coord.z - begin_coord.z + 2 * border_size);
+    // The noise coordinates of the columns, followed by a row of noise.
+    const size_t x_size = heightmap.x_size();
+    std::vector<float> buffer(2 * x_size);
+    float* const xs = buffer.data();
+    float* const row = xs + x_size;
+    for (size_t vx = 0; vx < x_size; ++vx) {
+        xs[vx] = (begin_coord.x + (int)vx - border_size) * scale;
+    }
+    for (size_t vz = 0; vz < heightmap.z_size(); ++vz) {
+        const float z = (begin_coord.z + (int)vz - border_size) * scale;
+        noise.fractal_row(xs, x_size, z, settings.octaves, row);
+
+        for (size_t vx = 0; vx < x_size; ++vx) {
+            const float y = settings.mean_height
+                + settings.height_variation * row[vx];
+            const int height = int(y * y_size);
+            heightmap.at(vx, vz) = std::min(std::max(height, 0), y_size - 1);
+        }
+    }
+    return heightmap;
+}
+
+Volume<Voxel> NoiseTerrain::volume(
+        const glm::ivec3 begin_coord,
+        const glm::ivec3 end_coord,
+        const int border_size)
+    const
+{
+    const Heightmap heights = heightmap(begin_coord, end_coord, border_size);
+    Volume<Voxel> volume = volume_from_heightmap(
+            heights, end_coord.y - begin_coord.y, border_size);
+    if (settings.caves) {
+        carve_caves(volume, heights, begin_coord, border_size);
+    }
+    return volume;
+}
+
+// Density is sampled on a lattice of cave_lattice_step voxels aligned to
+// world coordinates and interpolated in between, which is far cheaper than
+// sampling every voxel and the same on both sides of a chunk border. Only
+// the voxels up to the top of each column can be solid, so the air above
+// it is not looked at. The lowest layer of the world is kept, so that there
+// is always a floor.
+void NoiseTerrain::carve_caves(
+        Volume<Voxel>& volume,
+        const Heightmap& heights,
+        const glm::ivec3 begin_coord,
+        const int border_size)
+    const
+{
+    constexpr int step = cave_lattice_step;
+    const float scale = 1 / settings.cave_feature_size;
+    // Decorrelated from the heights.
+    const Noise noise(settings.seed ^ 0xCA7E5EEDu);
+
+    // World coordinates of the first voxel, and the lattice points from the
+    // cell containing it to the far corner of the cell of the last voxel.
+    const glm::ivec3 world_begin = begin_coord - border_size;
+    const glm::ivec3 size(volume.size_x(), volume.size_y(), volume.size_z());
+    const auto floor_div = [](int a, int b) {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    };
+    glm::ivec3 lattice_begin;
+    glm::ivec3 lattice_size;
+    for (int i = 0; i < 3; ++i) {
+        lattice_begin[i] = floor_div(world_begin[i], step);
+        lattice_size[i] =
+            floor_div(world_begin[i] + size[i] - 1, step) - lattice_begin[i]
+            + 2;
+    }
+
+    std::vector<float> lattice(
+            lattice_size.x * lattice_size.y * lattice_size.z);
+    const auto lattice_at = [&](int x, int y, int z) -> float& {
+        return lattice[(z * lattice_size.y + y) * lattice_size.x + x];
+    };
+    for (int z = 0; z < lattice_size.z; ++z) {
+        for (int y = 0; y < lattice_size.y; ++y) {
+            for (int x = 0; x < lattice_size.x; ++x) {
+                const glm::vec3 p =
+                    glm::vec3(lattice_begin + glm::ivec3(x, y, z))
+                    * float(step) * scale;
+                lattice_at(x, y, z) =
+                    noise.fractal(p.x, p.y, p.z, settings.cave_octaves);
+            }
+        }
+    }
+
+    for (int vz = 0; vz < size.z; ++vz) {
+        const int world_z = world_begin.z + vz;
+        const int lz = floor_div(world_z, step) - lattice_begin.z;
+        const float tz = (world_z - (lz + lattice_begin.z) * step)
+            / float(step);
+        for (int vx = 0; vx < size.x; ++vx) {
+            const int world_x = world_begin.x + vx;
+            const int lx = floor_div(world_x, step) - lattice_begin.x;
+            const float tx = (world_x - (lx + lattice_begin.x) * step)
+                / float(step);
+            const int top = border_size + heights.at(vx, vz);
+            for (int vy = 0; vy <= top; ++vy) {
+                const int world_y = world_begin.y + vy;
+                if (world_y <= begin_coord.y) {
+                    continue;
+                }
+                const int ly = floor_div(world_y, step) - lattice_begin.y;
+                const float ty = (world_y - (ly + lattice_begin.y) * step)
+                    / float(step);
+
+                float layers[2];
+                for (int dz = 0; dz <= 1; ++dz) {
+                    const float d00 = lattice_at(lx, ly, lz + dz);
+                    const float d10 = lattice_at(lx + 1, ly, lz + dz);
+                    const float d01 = lattice_at(lx, ly + 1, lz + dz);
+                    const float d11 = lattice_at(lx + 1, ly + 1, lz + dz);
+                    layers[dz] = d00 + ty * (d01 - d00)
+                        + tx * (d10 - d00 + ty * (d11 - d10 - d01 + d00));
+                }
+                const float density = layers[0] + tz * (layers[1] - layers[0]);
+                if (density > settings.cave_threshold) {
+                    volume.at(vx, vy, vz) = Voxel::empty;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include "volume.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// A volume storing a palette of the distinct values in it, plus the index
+// into the palette of every element. Indices are packed into 64-bit words
+// using as few bits as the palette size allows: 0 (no index array at all
+// for a single value), 1, 2, 4, 8 or 16. Setting an element to a new value
+// grows the palette and widens the indices if needed; the palette is never
+// shrunk.
+template <typename T>
+class PaletteVolume
+{
+public:
+    PaletteVolume(size_t x, size_t y, size_t z, T init)
+        : s_x(x)
+        , s_y(y)
+        , s_z(z)
+        , s_xy(x * y)
+        , palette(1, init)
+    {}
+
+    explicit PaletteVolume(const Volume<T>&);
+    // Rows begin_y up to end_y of the volume, read in place.
+    PaletteVolume(const Volume<T>&, size_t begin_y, size_t end_y);
+
+    size_t size_x() const { return s_x; }
+    size_t size_y() const { return s_y; }
+    size_t size_z() const { return s_z; }
+    size_t byte_size() const;
+
+    const std::vector<T>& palette_entries() const { return palette; }
+    int bits_per_index() const { return index_bits; }
+
+    T at(size_t x, size_t y, size_t z) const;
+    T at(glm::ivec3 v) const { return at(v.x, v.y, v.z); }
+    void set(size_t x, size_t y, size_t z, T);
+
+    // Calls f(x, palette_index) for every element of row (y, z), in order.
+    template <typename F>
+    void for_each_index_in_row(size_t y, size_t z, F) const;
+private:
+    static constexpr int word_bits = 64;
+
+    size_t s_x;
+    size_t s_y;
+    size_t s_z;
+    size_t s_xy;
+
+    std::vector<T> palette;
+    std::vector<uint64_t> indices;
+    int index_bits = 0;
+
+    size_t linear_index(size_t x, size_t y, size_t z) const;
+    uint32_t read(size_t) const;
+    void write(size_t, uint32_t);
+    uint32_t palette_index_of(T);
+    void widen(int new_index_bits);
+
+    static int index_bits_for(size_t palette_size);
+};
+
+template <typename T>
+PaletteVolume<T>::PaletteVolume(const Volume<T>& volume)
+    : PaletteVolume(volume, 0, volume.size_y())
+{}
+
+template <typename T>
+PaletteVolume<T>::PaletteVolume(
+        const Volume<T>& volume, const size_t begin_y, const size_t end_y)
+    : PaletteVolume(
+            volume.size_x(), end_y - begin_y, volume.size_z(),
+            volume.at(0, begin_y, 0))
+{
+    assert(begin_y < end_y);
+    assert(end_y <= volume.size_y());
+
+    const auto for_each_element = [&](auto f) {
+        for (size_t z = 0; z < s_z; ++z) {
+            for (size_t y = 0; y < s_y; ++y) {
+                for (size_t x = 0; x < s_x; ++x) {
+                    f(x, y, z, volume.at(x, begin_y + y, z));
+                }
+            }
+        }
+    };
+
+    for_each_element([&](auto, auto, auto, const T& value) {
+        if (std::find(palette.begin(), palette.end(), value)
+                == palette.end()) {
+            palette.push_back(value);
+        }
+    });
+
+    index_bits = index_bits_for(palette.size());
+    if (index_bits == 0) {
+        return;
+    }
+
+    indices.assign((s_xy * s_z * index_bits + word_bits - 1) / word_bits, 0);
+    for_each_element([&](auto x, auto y, auto z, const T& value) {
+        const auto found = std::find(palette.begin(), palette.end(), value);
+        this->write(this->linear_index(x, y, z), found - palette.begin());
+    });
+}
+
+template <typename T>
+size_t PaletteVolume<T>::byte_size() const
+{
+    return indices.size() * sizeof(uint64_t) + palette.size() * sizeof(T);
+}
+
+template <typename T>
+T PaletteVolume<T>::at(const size_t x, const size_t y, const size_t z) const
+{
+    return palette[read(linear_index(x, y, z))];
+}
+
+template <typename T>
+void PaletteVolume<T>::set(
+        const size_t x, const size_t y, const size_t z, const T value)
+{
+    const uint32_t palette_index = palette_index_of(value);
+    if (index_bits != 0) {
+        write(linear_index(x, y, z), palette_index);
+    }
+}
+
+template <typename T>
+template <typename F>
+void PaletteVolume<T>::for_each_index_in_row(
+        const size_t y, const size_t z, F f) const
+{
+    const size_t begin = linear_index(0, y, z);
+
+    if (index_bits == 0) {
+        for (size_t x = 0; x < s_x; ++x) {
+            f(x, 0);
+        }
+        return;
+    }
+
+    const uint64_t mask = (uint64_t(1) << index_bits) - 1;
+    size_t bit = begin * index_bits;
+    for (size_t x = 0; x < s_x; ++x, bit += index_bits) {
+        f(x, uint32_t(indices[bit / word_bits] >> (bit % word_bits) & mask));
+    }
+}
+
+template <typename T>
+size_t PaletteVolume<T>::linear_index(
+        const size_t x, const size_t y, const size_t z) const
+{
+    assert(x < s_x);
+    assert(y < s_y);
+    assert(z < s_z);
+
+    return z * s_xy + y * s_x + x;
+}
+
+// Index widths divide the word size, so no index spans two words.
+template <typename T>
+uint32_t PaletteVolume<T>::read(const size_t i) const
+{
+    if (index_bits == 0) {
+        return 0;
+    }
+    const size_t bit = i * index_bits;
+    const uint64_t mask = (uint64_t(1) << index_bits) - 1;
+    return indices[bit / word_bits] >> (bit % word_bits) & mask;
+}
+
+template <typename T>
+void PaletteVolume<T>::write(const size_t i, const uint32_t palette_index)
+{
+    assert(index_bits != 0);
+    assert(palette_index < (uint32_t(1) << index_bits));
+
+    const size_t bit = i * index_bits;
+    const uint64_t mask = (uint64_t(1) << index_bits) - 1;
+    uint64_t& word = indices[bit / word_bits];
+    word = (word & ~(mask << (bit % word_bits)))
+        | uint64_t(palette_index) << (bit % word_bits);
+}
+
+template <typename T>
+uint32_t PaletteVolume<T>::palette_index_of(const T value)
+{
+    const auto found = std::find(palette.begin(), palette.end(), value);
+    if (found != palette.end()) {
+        return found - palette.begin();
+    }
+
+    palette.push_back(value);
+    const int needed_bits = index_bits_for(palette.size());
+    if (needed_bits != index_bits) {
+        widen(needed_bits);
+    }
+    return palette.size() - 1;
+}
+
+template <typename T>
+void PaletteVolume<T>::widen(const int new_index_bits)
+{
+    const size_t size = s_xy * s_z;
+    std::vector<uint64_t> old_indices(
+            (size * new_index_bits + word_bits - 1) / word_bits, 0);
+    old_indices.swap(indices);
+    const int old_index_bits = index_bits;
+    index_bits = new_index_bits;
+
+    if (old_index_bits == 0) {
+        return;
+    }
+
+    const uint64_t old_mask = (uint64_t(1) << old_index_bits) - 1;
+    for (size_t i = 0; i < size; ++i) {
+        const size_t bit = i * old_index_bits;
+        write(i, old_indices[bit / word_bits] >> (bit % word_bits) & old_mask);
+    }
+}
+
+template <typename T>
+int PaletteVolume<T>::index_bits_for(const size_t palette_size)
+{
+    assert(palette_size <= (size_t(1) << 16));
+
+    int bits = 0;
+    while ((size_t(1) << bits) < palette_size) {
+        bits = bits == 0 ? 1 : 2 * bits;
+    }
+    return bits;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "chunk.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// Values by chunk, ordered by when they were last drawn, for
+// ChunkMeshRepository to evict the meshes that have been out of view
+// longest. Knows which chunks have been drawn during the current frame, so
+// that those are never offered for eviction.
+template <typename T>
+class RecentlyDrawn
+{
+public:
+    size_t size() const { return entries.size(); }
+
+    // Null if there is none. Does not count as drawing it.
+    T* find(ChunkId);
+    // Marks the chunk as drawn during the current frame. Null if there is
+    // none.
+    T* draw(ChunkId);
+    // Counts as drawn during the current frame. There must be none yet.
+    T& insert(ChunkId, T&&);
+    void erase(ChunkId);
+
+    // Sets chunk_id to the least recently drawn chunk and returns true,
+    // unless every chunk has been drawn during the current frame.
+    bool least_recently_drawn(ChunkId& chunk_id) const;
+
+    // Erase the least recently drawn values until at most max_size are
+    // left, or one less than capacity so that another fits, but never those
+    // drawn during the current frame. Return how many they erased.
+    size_t shrink_to(size_t max_size);
+    size_t make_room(size_t capacity);
+
+    void next_frame() { ++current_frame; }
+private:
+    struct Entry
+    {
+        T value;
+        std::list<ChunkId>::iterator lru_position;
+        uint64_t last_drawn_frame;
+    };
+
+    std::unordered_map<ChunkId, Entry> entries;
+    // Most recently drawn first.
+    std::list<ChunkId> lru_order;
+    uint64_t current_frame = 0;
+};
+
+template <typename T>
+T* RecentlyDrawn<T>::find(const ChunkId chunk_id)
+{
+    auto found = entries.find(chunk_id);
+    return found != entries.end() ? &found->second.value : nullptr;
+}
+
+template <typename T>
+T* RecentlyDrawn<T>::draw(const ChunkId chunk_id)
+{
+    auto found = entries.find(chunk_id);
+    if (found == entries.end()) {
+        return nullptr;
+    }
+    lru_order.splice(lru_order.begin(), lru_order, found->second.lru_position);
+    found->second.last_drawn_frame = current_frame;
+    return &found->second.value;
+}
+
+template <typename T>
+T& RecentlyDrawn<T>::insert(const ChunkId chunk_id, T&& value)
+{
+    assert(entries.find(chunk_id) == entries.end());
+
+    lru_order.push_front(chunk_id);
+    return entries.insert({ chunk_id, Entry {
+            std::move(value), lru_order.begin(), current_frame } })
+        .first->second.value;
+}
+
+template <typename T>
+void RecentlyDrawn<T>::erase(const ChunkId chunk_id)
+{
+    auto found = entries.find(chunk_id);
+    if (found != entries.end()) {
+        lru_order.erase(found->second.lru_position);
+        entries.erase(found);
+    }
+}
+
+// The least recently drawn chunk was drawn during the current frame only if
+// all of them were.
+template <typename T>
+bool RecentlyDrawn<T>::least_recently_drawn(ChunkId& chunk_id) const
+{
+    if (lru_order.empty()) {
+        return false;
+    }
+    const auto found = entries.find(lru_order.back());
+    assert(found != entries.end());
+    if (found->second.last_drawn_frame == current_frame) {
+        return false;
+    }
+    chunk_id = found->first;
+    return true;
+}
+
+template <typename T>
+size_t RecentlyDrawn<T>::shrink_to(const size_t max_size)
+{
+    size_t erased = 0;
+    ChunkId chunk_id;
+    while (entries.size() > max_size && least_recently_drawn(chunk_id)) {
+        erase(chunk_id);
+        ++erased;
+    }
+    return erased;
+}
+
+template <typename T>
+size_t RecentlyDrawn<T>::make_room(const size_t capacity)
+{
+    return shrink_to(capacity > 0 ? capacity - 1 : 0);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A bounded queue that any number of threads can push to and one thread
+// pops from, without locks. Every slot carries a sequence number telling
+// whether it is free to be written or ready to be read, so producers only
+// contend on claiming a position and never wait for each other to finish
+// writing. Pushing to a full buffer fails instead of waiting.
+//
+// Capacity has to be a power of two.
+template <typename T, size_t Capacity>
+class RingBuffer
+{
+public:
+    RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    bool try_push(const T&);
+    // Only to be called from one thread at a time.
+    bool try_pop(T&);
+private:
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+            "capacity is a power of two");
+    static constexpr size_t mask = Capacity - 1;
+
+    struct Slot
+    {
+        // Equal to the position for a free slot to be written at that
+        // position, one past it once the value has been written.
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::array<Slot, Capacity> slots;
+    // On separate cache lines, written by the producers and the consumer.
+    alignas(64) std::atomic<size_t> push_position;
+    alignas(64) size_t pop_position;
+};
+
+template <typename T, size_t Capacity>
+RingBuffer<T, Capacity>::RingBuffer()
+    : push_position(0)
+    , pop_position(0)
+{
+    for (size_t i = 0; i < Capacity; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T, size_t Capacity>
+bool RingBuffer<T, Capacity>::try_push(const T& value)
+{
+    size_t position = push_position.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots[position & mask];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const intptr_t difference = intptr_t(sequence) - intptr_t(position);
+        if (difference == 0) {
+            if (push_position.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // The slot still holds the value from one lap ago.
+            return false;
+        } else {
+            position = push_position.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->value = value;
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T, size_t Capacity>
+bool RingBuffer<T, Capacity>::try_pop(T& value)
+{
+    Slot& slot = slots[pop_position & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != pop_position + 1) {
+        return false;
+    }
+
+    value = slot.value;
+    slot.sequence.store(pop_position + Capacity, std::memory_order_release);
+    ++pop_position;
+    return true;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include "palette_volume.hpp"
+#include "volume.hpp"
+#include "voxel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// A volume split along y into sections that are palette compressed on their
+// own. Sections of a single value, like the air above the terrain or the
+// rock deep below it, store no palette indices at all.
+//
+// The interior of the volume, between border_size rows at the bottom and at
+// the top, is split into sections of section_height rows. The border rows
+// belong to the lowest and the highest section.
+class SectionedVolume
+{
+public:
+    SectionedVolume(
+            const Volume<Voxel>&,
+            size_t border_size,
+            size_t section_height);
+
+    size_t size_x() const { return s_x; }
+    size_t size_y() const { return s_y; }
+    size_t size_z() const { return s_z; }
+    size_t byte_size() const;
+
+    size_t section_count() const { return sections.size(); }
+    const PaletteVolume<Voxel>& section(size_t i) const { return sections[i]; }
+    // The first row of the volume that belongs to the section.
+    size_t section_begin_y(size_t) const;
+    // Whether every voxel of the section has the same value.
+    bool section_uniform(size_t i) const;
+
+    Voxel at(size_t x, size_t y, size_t z) const;
+    Voxel at(glm::ivec3 v) const { return at(v.x, v.y, v.z); }
+    void set(size_t x, size_t y, size_t z, Voxel);
+    void set(glm::ivec3 v, Voxel voxel) { set(v.x, v.y, v.z, voxel); }
+
+    // Calls f(x, value) for every element of row (y, z), in order.
+    template <typename F>
+    void for_each_in_row(size_t y, size_t z, F) const;
+private:
+    size_t s_x;
+    size_t s_y;
+    size_t s_z;
+    size_t border_size;
+    size_t section_height;
+
+    std::vector<PaletteVolume<Voxel>> sections;
+
+    size_t section_of(size_t y) const;
+};
+
+SectionedVolume::SectionedVolume(
+        const Volume<Voxel>& volume,
+        const size_t bs,
+        const size_t sh)
+    : s_x(volume.size_x())
+    , s_y(volume.size_y())
+    , s_z(volume.size_z())
+    , border_size(bs)
+    , section_height(sh)
+{
+    assert(s_y > 2 * border_size);
+    assert((s_y - 2 * border_size) % section_height == 0);
+
+    const size_t count = (s_y - 2 * border_size) / section_height;
+    sections.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t begin_y = section_begin_y(i);
+        const size_t end_y = i + 1 == count ? s_y : section_begin_y(i + 1);
+        sections.emplace_back(volume, begin_y, end_y);
+    }
+}
+
+size_t SectionedVolume::byte_size() const
+{
+    size_t bytes = 0;
+    for (const auto& section : sections) {
+        bytes += section.byte_size();
+    }
+    return bytes;
+}
+
+size_t SectionedVolume::section_begin_y(const size_t i) const
+{
+    return i == 0 ? 0 : border_size + i * section_height;
+}
+
+bool SectionedVolume::section_uniform(const size_t i) const
+{
+    return sections[i].palette_entries().size() == 1;
+}
+
+Voxel SectionedVolume::at(const size_t x, const size_t y, const size_t z)
+    const
+{
+    const size_t i = section_of(y);
+    return sections[i].at(x, y - section_begin_y(i), z);
+}
+
+void SectionedVolume::set(
+        const size_t x, const size_t y, const size_t z, const Voxel voxel)
+{
+    const size_t i = section_of(y);
+    sections[i].set(x, y - section_begin_y(i), z, voxel);
+}
+
+template <typename F>
+void SectionedVolume::for_each_in_row(const size_t y, const size_t z, F f)
+    const
+{
+    const size_t i = section_of(y);
+    const auto& palette = sections[i].palette_entries();
+    sections[i].for_each_index_in_row(
+            y - section_begin_y(i), z, [&](size_t x, uint32_t index) {
+        f(x, palette[index]);
+    });
+}
+
+size_t SectionedVolume::section_of(const size_t y) const
+{
+    assert(y < s_y);
+
+    if (y < border_size + section_height) {
+        return 0;
+    }
+    return std::min((y - border_size) / section_height, sections.size() - 1);
+}
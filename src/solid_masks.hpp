@@ -0,0 +1,471 @@
+#pragma once
+
+#include "bit_volume.hpp"
+#include "chunk.hpp"
+#include "chunk_neighborhood.hpp"
+#include "column_volume.hpp"
+#include "heightmap.hpp"
+#include "palette_volume.hpp"
+#include "sectioned_volume.hpp"
+#include "volume.hpp"
+#include "voxel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// The solid voxels of a volume with a one voxel border, packed into one
+// 64-bit word per (y, z) row. Bit i of a row stands for the voxel at
+// x = i + 1, the two border voxels of the row are kept in a separate byte
+// so that whole rows can be shifted onto their x neighbors.
+class SolidMasks
+{
+public:
+    static constexpr size_t max_interior_x = 64;
+
+    // Interior rows are grouped into sections of Chunks::section_height
+    // rows. A section whose voxels are all empty, or which is solid along
+    // with all the voxels around it, has no visible faces.
+    enum class Uniformity { mixed, empty, solid };
+
+    void load(const Volume<Voxel>&);
+    void load(const BitVolume&);
+    void load(const PaletteVolume<Voxel>&);
+    void load(const ColumnVolume&);
+    void load(const SectionedVolume&);
+    void load(const ChunkNeighborhood&);
+    // The volume volume_from_heightmap would fill, every column solid up to
+    // border_size plus its height. Sections are summarized from the lowest
+    // and highest column alone.
+    void load(const Heightmap&, size_t y_size, size_t border_size);
+
+    size_t size_x() const { return s_x; }
+    size_t size_y() const { return s_y; }
+    size_t size_z() const { return s_z; }
+
+    size_t section_count() const { return uniformities.size(); }
+    size_t section_begin_y(size_t i) const;
+    size_t section_end_y(size_t i) const;
+    Uniformity section_uniformity(size_t i) const { return uniformities[i]; }
+
+    bool solid(size_t x, size_t y, size_t z) const;
+    bool solid(glm::ivec3 v) const { return solid(v.x, v.y, v.z); }
+
+    // Interior voxels of row (y, z) that have a visible face towards each
+    // of the directions -x, +x, -y, +y, -z and +z.
+    void visible_faces(size_t y, size_t z, uint64_t (&faces)[6]) const;
+private:
+    static constexpr uint8_t left_border_bit = 1;
+    static constexpr uint8_t right_border_bit = 2;
+
+    std::vector<uint64_t> rows;
+    std::vector<uint8_t> borders;
+    std::vector<Uniformity> uniformities;
+    size_t s_x = 0;
+    size_t s_y = 0;
+    size_t s_z = 0;
+
+    size_t row_index(size_t y, size_t z) const { return z * s_y + y; }
+    uint64_t full_row() const;
+
+    void resize(size_t x, size_t y, size_t z);
+    void summarize_sections();
+    bool rows_empty(size_t begin_y, size_t end_y) const;
+    bool rows_solid(size_t begin_y, size_t end_y) const;
+};
+
+void SolidMasks::resize(const size_t x, const size_t y, const size_t z)
+{
+    s_x = x;
+    s_y = y;
+    s_z = z;
+    assert(s_x >= 2 && s_x - 2 <= max_interior_x);
+
+    rows.assign(s_y * s_z, 0);
+    borders.assign(s_y * s_z, 0);
+
+    const size_t section_height = Chunks::section_height;
+    uniformities.assign(
+            (s_y - 2 + section_height - 1) / section_height,
+            Uniformity::mixed);
+}
+
+void SolidMasks::load(const Volume<Voxel>& volume)
+{
+    resize(volume.size_x(), volume.size_y(), volume.size_z());
+
+    for (size_t z = 0; z < s_z; ++z) {
+        for (size_t y = 0; y < s_y; ++y) {
+            uint64_t row = 0;
+            for (size_t x = 1; x < s_x - 1; ++x) {
+                if (volume.at(x, y, z) != Voxel::empty) {
+                    row |= uint64_t(1) << (x - 1);
+                }
+            }
+            rows[row_index(y, z)] = row;
+
+            uint8_t border = 0;
+            if (volume.at(0, y, z) != Voxel::empty) {
+                border |= left_border_bit;
+            }
+            if (volume.at(s_x - 1, y, z) != Voxel::empty) {
+                border |= right_border_bit;
+            }
+            borders[row_index(y, z)] = border;
+        }
+    }
+
+    summarize_sections();
+}
+
+void SolidMasks::load(const BitVolume& volume)
+{
+    resize(volume.size_x(), volume.size_y(), volume.size_z());
+
+    const uint64_t interior_mask = full_row();
+
+    for (size_t z = 0; z < s_z; ++z) {
+        for (size_t y = 0; y < s_y; ++y) {
+            rows[row_index(y, z)] = volume.row_bits(1, y, z) & interior_mask;
+
+            uint8_t border = 0;
+            if (volume.at(0, y, z) != Voxel::empty) {
+                border |= left_border_bit;
+            }
+            if (volume.at(s_x - 1, y, z) != Voxel::empty) {
+                border |= right_border_bit;
+            }
+            borders[row_index(y, z)] = border;
+        }
+    }
+
+    summarize_sections();
+}
+
+void SolidMasks::load(const PaletteVolume<Voxel>& volume)
+{
+    resize(volume.size_x(), volume.size_y(), volume.size_z());
+
+    const auto& palette = volume.palette_entries();
+    std::vector<bool> solid_entries(palette.size());
+    std::transform(palette.begin(), palette.end(), solid_entries.begin(),
+            [](Voxel voxel) { return voxel != Voxel::empty; });
+
+    for (size_t z = 0; z < s_z; ++z) {
+        for (size_t y = 0; y < s_y; ++y) {
+            uint64_t row = 0;
+            uint8_t border = 0;
+            volume.for_each_index_in_row(y, z, [&](size_t x, uint32_t i) {
+                if (!solid_entries[i]) {
+                    return;
+                } else if (x == 0) {
+                    border |= left_border_bit;
+                } else if (x == s_x - 1) {
+                    border |= right_border_bit;
+                } else {
+                    row |= uint64_t(1) << (x - 1);
+                }
+            });
+            rows[row_index(y, z)] = row;
+            borders[row_index(y, z)] = border;
+        }
+    }
+
+    summarize_sections();
+}
+
+void SolidMasks::load(const ColumnVolume& volume)
+{
+    resize(volume.size_x(), volume.size_y(), volume.size_z());
+
+    for (size_t z = 0; z < s_z; ++z) {
+        for (size_t x = 0; x < s_x; ++x) {
+            volume.for_each_run_in_column(x, z,
+                    [&](size_t begin_y, size_t end_y, Voxel value) {
+                if (value == Voxel::empty) {
+                    return;
+                }
+                for (size_t y = begin_y; y < end_y; ++y) {
+                    if (x == 0) {
+                        borders[row_index(y, z)] |= left_border_bit;
+                    } else if (x == s_x - 1) {
+                        borders[row_index(y, z)] |= right_border_bit;
+                    } else {
+                        rows[row_index(y, z)] |= uint64_t(1) << (x - 1);
+                    }
+                }
+            });
+        }
+    }
+
+    summarize_sections();
+}
+
+void SolidMasks::load(
+        const Heightmap& heightmap,
+        const size_t y_size,
+        const size_t border_size)
+{
+    resize(heightmap.x_size(), y_size + 2 * border_size, heightmap.z_size());
+
+    for (size_t z = 0; z < s_z; ++z) {
+        for (size_t x = 0; x < s_x; ++x) {
+            const size_t top = border_size + heightmap.at(x, z);
+            assert(top < s_y);
+            for (size_t y = 0; y <= top; ++y) {
+                if (x == 0) {
+                    borders[row_index(y, z)] |= left_border_bit;
+                } else if (x == s_x - 1) {
+                    borders[row_index(y, z)] |= right_border_bit;
+                } else {
+                    rows[row_index(y, z)] |= uint64_t(1) << (x - 1);
+                }
+            }
+        }
+    }
+
+    const size_t lowest_top = border_size + heightmap.min_height();
+    const size_t highest_top = border_size + heightmap.max_height();
+    for (size_t i = 0; i < section_count(); ++i) {
+        if (highest_top < section_begin_y(i)) {
+            uniformities[i] = Uniformity::empty;
+        } else if (lowest_top >= section_end_y(i)) {
+            uniformities[i] = Uniformity::solid;
+        }
+    }
+}
+
+// Uniform sections of the volume fill their rows without looking at each
+// voxel.
+void SolidMasks::load(const SectionedVolume& volume)
+{
+    resize(volume.size_x(), volume.size_y(), volume.size_z());
+
+    std::vector<bool> solid_entries;
+    for (size_t i = 0; i < volume.section_count(); ++i) {
+        const PaletteVolume<Voxel>& section = volume.section(i);
+        const size_t begin_y = volume.section_begin_y(i);
+        const auto& palette = section.palette_entries();
+
+        if (volume.section_uniform(i)) {
+            if (palette.front() == Voxel::empty) {
+                continue;
+            }
+            for (size_t z = 0; z < s_z; ++z) {
+                for (size_t y = 0; y < section.size_y(); ++y) {
+                    rows[row_index(begin_y + y, z)] = full_row();
+                    borders[row_index(begin_y + y, z)] =
+                        left_border_bit | right_border_bit;
+                }
+            }
+            continue;
+        }
+
+        solid_entries.resize(palette.size());
+        std::transform(palette.begin(), palette.end(), solid_entries.begin(),
+                [](Voxel voxel) { return voxel != Voxel::empty; });
+
+        for (size_t z = 0; z < s_z; ++z) {
+            for (size_t y = 0; y < section.size_y(); ++y) {
+                uint64_t row = 0;
+                uint8_t border = 0;
+                section.for_each_index_in_row(y, z, [&](size_t x, uint32_t j) {
+                    if (!solid_entries[j]) {
+                        return;
+                    } else if (x == 0) {
+                        border |= left_border_bit;
+                    } else if (x == s_x - 1) {
+                        border |= right_border_bit;
+                    } else {
+                        row |= uint64_t(1) << (x - 1);
+                    }
+                });
+                rows[row_index(begin_y + y, z)] = row;
+                borders[row_index(begin_y + y, z)] = border;
+            }
+        }
+    }
+
+    summarize_sections();
+}
+
+// Every interior voxel of a row solid.
+uint64_t SolidMasks::full_row() const
+{
+    const size_t interior_x = s_x - 2;
+    return interior_x == max_interior_x
+        ? ~uint64_t(0)
+        : (uint64_t(1) << interior_x) - 1;
+}
+
+// As with a SectionedVolume, uniform sections of the center volumes fill
+// their rows without looking at each voxel. Only the border voxels are read
+// from the neighbors on either side, and not even those where their section
+// is uniform. The volumes of a neighborhood share their sections.
+void SolidMasks::load(const ChunkNeighborhood& neighborhood)
+{
+    resize(neighborhood.size_x(), neighborhood.size_y(),
+            neighborhood.size_z());
+
+    const size_t inner_x = s_x - 2;
+    const size_t inner_z = s_z - 2;
+    // The value of every voxel of section i if it is uniform.
+    const auto uniform_value = [](const SectionedVolume& volume, size_t i,
+            Voxel& value) {
+        if (!volume.section_uniform(i)) {
+            return false;
+        }
+        value = volume.section(i).palette_entries().front();
+        return true;
+    };
+    for (size_t z = 0; z < s_z; ++z) {
+        const int dz = z == 0 ? -1 : z == s_z - 1 ? 1 : 0;
+        const size_t volume_z = dz == 0 ? z - 1 : dz < 0 ? inner_z - 1 : 0;
+        const SectionedVolume& left = neighborhood.volume(-1, dz);
+        const SectionedVolume& center = neighborhood.volume(0, dz);
+        const SectionedVolume& right = neighborhood.volume(1, dz);
+
+        // Below the chunks is solid, above them stays empty.
+        rows[row_index(0, z)] = full_row();
+        borders[row_index(0, z)] = left_border_bit | right_border_bit;
+
+        for (size_t i = 0; i < center.section_count(); ++i) {
+            const PaletteVolume<Voxel>& section = center.section(i);
+            const auto& palette = section.palette_entries();
+            const size_t begin_y = center.section_begin_y(i);
+            Voxel center_value;
+            Voxel left_value;
+            Voxel right_value;
+            const bool center_uniform =
+                uniform_value(center, i, center_value);
+            const bool left_uniform = uniform_value(left, i, left_value);
+            const bool right_uniform = uniform_value(right, i, right_value);
+
+            // Rows of the masks are one above those of the volumes.
+            for (size_t y = begin_y; y < begin_y + section.size_y(); ++y) {
+                uint64_t row = 0;
+                if (!center_uniform) {
+                    section.for_each_index_in_row(y - begin_y, volume_z,
+                            [&](size_t x, uint32_t j) {
+                        if (palette[j] != Voxel::empty) {
+                            row |= uint64_t(1) << x;
+                        }
+                    });
+                } else if (center_value != Voxel::empty) {
+                    row = full_row();
+                }
+                rows[row_index(y + 1, z)] = row;
+
+                const Voxel left_voxel = left_uniform
+                    ? left_value : left.at(inner_x - 1, y, volume_z);
+                const Voxel right_voxel = right_uniform
+                    ? right_value : right.at(0, y, volume_z);
+                uint8_t border = 0;
+                if (left_voxel != Voxel::empty) {
+                    border |= left_border_bit;
+                }
+                if (right_voxel != Voxel::empty) {
+                    border |= right_border_bit;
+                }
+                borders[row_index(y + 1, z)] = border;
+            }
+        }
+    }
+
+    summarize_sections();
+}
+
+size_t SolidMasks::section_begin_y(const size_t i) const
+{
+    assert(i < section_count());
+
+    return 1 + i * Chunks::section_height;
+}
+
+size_t SolidMasks::section_end_y(const size_t i) const
+{
+    assert(i < section_count());
+
+    return std::min(1 + (i + 1) * Chunks::section_height, s_y - 1);
+}
+
+void SolidMasks::summarize_sections()
+{
+    for (size_t i = 0; i < section_count(); ++i) {
+        const size_t begin_y = section_begin_y(i);
+        const size_t end_y = section_end_y(i);
+        if (rows_empty(begin_y, end_y)) {
+            uniformities[i] = Uniformity::empty;
+        } else if (rows_solid(begin_y - 1, end_y + 1)) {
+            uniformities[i] = Uniformity::solid;
+        } else {
+            uniformities[i] = Uniformity::mixed;
+        }
+    }
+}
+
+// Only the interior voxels of the rows count.
+bool SolidMasks::rows_empty(const size_t begin_y, const size_t end_y) const
+{
+    for (size_t z = 1; z < s_z - 1; ++z) {
+        for (size_t y = begin_y; y < end_y; ++y) {
+            if (rows[row_index(y, z)] != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// All voxels of the rows count, including the border ones.
+bool SolidMasks::rows_solid(const size_t begin_y, const size_t end_y) const
+{
+    const uint64_t full = full_row();
+    for (size_t z = 0; z < s_z; ++z) {
+        for (size_t y = begin_y; y < end_y; ++y) {
+            if (rows[row_index(y, z)] != full
+                    || borders[row_index(y, z)]
+                        != (left_border_bit | right_border_bit)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool SolidMasks::solid(const size_t x, const size_t y, const size_t z) const
+{
+    assert(x < s_x);
+    assert(y < s_y);
+    assert(z < s_z);
+
+    const size_t index = row_index(y, z);
+    if (x == 0) {
+        return borders[index] & left_border_bit;
+    } else if (x == s_x - 1) {
+        return borders[index] & right_border_bit;
+    } else {
+        return rows[index] >> (x - 1) & 1;
+    }
+}
+
+void SolidMasks::visible_faces(
+        const size_t y, const size_t z, uint64_t (&faces)[6]) const
+{
+    assert(y >= 1 && y < s_y - 1);
+    assert(z >= 1 && z < s_z - 1);
+
+    const size_t index = row_index(y, z);
+    const uint64_t row = rows[index];
+    const uint64_t left_border = borders[index] & left_border_bit;
+    const uint64_t right_border =
+        (borders[index] & right_border_bit) ? uint64_t(1) << (s_x - 3) : 0;
+
+    faces[0] = row & ~(row << 1 | left_border);
+    faces[1] = row & ~(row >> 1 | right_border);
+    faces[2] = row & ~rows[row_index(y - 1, z)];
+    faces[3] = row & ~rows[row_index(y + 1, z)];
+    faces[4] = row & ~rows[row_index(y, z - 1)];
+    faces[5] = row & ~rows[row_index(y, z + 1)];
+}
@@ -0,0 +1,1031 @@
+// Checks of the chunk pipeline that run without a display or a GPU, built
+// and run by `make test`. Prints every failed check and exits with a
+// non-zero status if there were any.
+
+#define GLM_FORCE_RADIANS
+
+#include "bit_volume.hpp"
+#include "build_scheduler.hpp"
+#include "camera.hpp"
+#include "chunk.hpp"
+#include "chunk_neighborhood.hpp"
+#include "chunk_volume_repository.hpp"
+#include "column_volume.hpp"
+#include "frustum.hpp"
+#include "heightmap.hpp"
+#include "mesh_builder.hpp"
+#include "mesh_data.hpp"
+#include "noise.hpp"
+#include "noise_terrain.hpp"
+#include "palette_volume.hpp"
+#include "recently_drawn.hpp"
+#include "sectioned_volume.hpp"
+#include "solid_masks.hpp"
+#include "vertex.hpp"
+#include "visible_chunks.hpp"
+#include "volume.hpp"
+#include "volumegen.hpp"
+#include "voxel.hpp"
+#include "worker_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#define check(condition) \
+    check_that((condition), #condition, __FILE__, __LINE__)
+
+// The chunks around the origin that the app drew before it had a view
+// radius.
+constexpr int grid_radius = 2;
+constexpr int y_size = Chunks::y_end - Chunks::y_begin;
+
+// Of the sine terrain of volumegen.hpp on the grid, as the per-face
+// builder has produced it since before any of the meshing optimizations.
+constexpr size_t baseline_per_face_triangles = 287940;
+
+constexpr size_t volume_byte_budget = 64 << 20;
+
+// Of a chunk without a border, the size of a copy of one.
+constexpr size_t dense_volume_bytes =
+    Chunks::x_size * y_size * Chunks::z_size * sizeof(Voxel);
+
+constexpr size_t worker_count = 4;
+// Chunks of the worker pool test along x and z.
+constexpr int pool_grid_size = 8;
+
+constexpr int eviction_view_radius = 8;
+constexpr int eviction_frames = 72;
+constexpr float eviction_degrees_per_frame = 10;
+
+int failed_checks = 0;
+
+std::atomic<size_t> allocation_count(0);
+// Of at least dense_volume_bytes.
+std::atomic<size_t> volume_sized_allocation_count(0);
+
+void* operator new(size_t size)
+{
+    ++allocation_count;
+    if (size >= dense_volume_bytes) {
+        ++volume_sized_allocation_count;
+    }
+    if (void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Not inlined, so that the compiler does not take the free() for the
+// release of memory that did not come from malloc().
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void check_that(bool condition, const char* text, const char* file, int line);
+template <typename F>
+void run(const char* name, F f);
+
+std::vector<ChunkId> grid_chunks();
+Volume<Voxel> padded_volume(ChunkId);
+ChunkVolumeRepository::VolumeSampler sine_volume_sampler();
+size_t triangle_count(const MeshData&);
+std::vector<MeshData> build_sections(
+        ChunkVolumeRepository&, MeshBuilder&, ChunkId, Chunks::SectionSet);
+std::vector<uint64_t> unit_faces(const std::vector<MeshData>&);
+std::vector<uint64_t> unit_faces(const MeshData&);
+void append(std::vector<uint64_t>&, const std::vector<uint64_t>&);
+bool same_mesh(const MeshData&, const MeshData&);
+bool same_masks(const SolidMasks&, const SolidMasks&);
+
+void per_face_matches_baseline();
+void greedy_covers_per_face_surface();
+void meshing_paths_agree(MeshBuilder::Mode);
+void vertex_pack_round_trips();
+void mesh_vertices_within_chunk();
+void worker_pool_builds_like_one_thread();
+void drawn_chunks_not_evicted();
+void solid_masks_agree_across_volume_types();
+void chunks_not_copied();
+void edits_remesh_chunk_and_neighbors();
+void volumes_in_use_or_edited_not_evicted();
+void noise_rows_match_samples();
+void column_volumes_mesh_like_dense();
+void bit_volumes_match_dense();
+void scheduler_orders_and_limits_builds();
+void frustum_culls_and_orders_chunks();
+
+int main()
+{
+    run("per_face_matches_baseline", per_face_matches_baseline);
+    run("greedy_covers_per_face_surface", greedy_covers_per_face_surface);
+    run("meshing_paths_agree_per_face", [] {
+        meshing_paths_agree(MeshBuilder::Mode::per_face);
+    });
+    run("meshing_paths_agree_greedy", [] {
+        meshing_paths_agree(MeshBuilder::Mode::greedy);
+    });
+    run("vertex_pack_round_trips", vertex_pack_round_trips);
+    run("mesh_vertices_within_chunk", mesh_vertices_within_chunk);
+    run("worker_pool_builds_like_one_thread",
+            worker_pool_builds_like_one_thread);
+    run("drawn_chunks_not_evicted", drawn_chunks_not_evicted);
+    run("solid_masks_agree_across_volume_types",
+            solid_masks_agree_across_volume_types);
+    run("chunks_not_copied", chunks_not_copied);
+    run("edits_remesh_chunk_and_neighbors",
+            edits_remesh_chunk_and_neighbors);
+    run("volumes_in_use_or_edited_not_evicted",
+            volumes_in_use_or_edited_not_evicted);
+    run("noise_rows_match_samples", noise_rows_match_samples);
+    run("column_volumes_mesh_like_dense", column_volumes_mesh_like_dense);
+    run("bit_volumes_match_dense", bit_volumes_match_dense);
+    run("scheduler_orders_and_limits_builds",
+            scheduler_orders_and_limits_builds);
+    run("frustum_culls_and_orders_chunks", frustum_culls_and_orders_chunks);
+
+    if (failed_checks > 0) {
+        std::printf("%d checks failed\n", failed_checks);
+        return 1;
+    }
+    return 0;
+}
+
+void check_that(
+        const bool condition,
+        const char* const text,
+        const char* const file,
+        const int line)
+{
+    if (!condition) {
+        std::printf("  %s:%d: check failed: %s\n", file, line, text);
+        ++failed_checks;
+    }
+}
+
+template <typename F>
+void run(const char* const name, F f)
+{
+    const int failed_before = failed_checks;
+    f();
+    std::printf("%s %s\n", failed_checks == failed_before ? "ok  " : "FAIL",
+            name);
+}
+
+std::vector<ChunkId> grid_chunks()
+{
+    std::vector<ChunkId> chunks;
+    for (int z = -grid_radius; z <= grid_radius; ++z) {
+        for (int x = -grid_radius; x <= grid_radius; ++x) {
+            chunks.push_back({x, z});
+        }
+    }
+    return chunks;
+}
+
+// With the one voxel border that meshing a volume on its own needs.
+Volume<Voxel> padded_volume(const ChunkId chunk_id)
+{
+    return volume_from_heightmap(
+            sample_heightmap(
+                Chunks::begin_coord(chunk_id), Chunks::end_coord(chunk_id), 1),
+            y_size,
+            1);
+}
+
+ChunkVolumeRepository::VolumeSampler sine_volume_sampler()
+{
+    return [](glm::ivec3 begin, glm::ivec3 end, int border) {
+        return volume_from_heightmap(
+                sample_heightmap(begin, end, border), end.y - begin.y, border);
+    };
+}
+
+size_t triangle_count(const MeshData& mesh)
+{
+    return (mesh.short_indices.size() + mesh.indices.size()) / 3;
+}
+
+// Every unit square of voxel face the quads of the mesh cover, as its
+// position, normal and material packed like a vertex, sorted. Both
+// builders emit each quad as six consecutive indices.
+std::vector<uint64_t> unit_faces(const MeshData& mesh)
+{
+    const auto index_at = [&mesh](size_t i) -> uint32_t {
+        return mesh.short_indices.empty()
+            ? mesh.indices[i] : mesh.short_indices[i];
+    };
+    const size_t index_count = mesh.short_indices.size() + mesh.indices.size();
+
+    std::vector<uint64_t> faces;
+    for (size_t quad = 0; quad < index_count; quad += 6) {
+        glm::ivec3 min = Vertices::position(mesh.vertices[index_at(quad)]);
+        glm::ivec3 max = min;
+        for (size_t i = quad + 1; i < quad + 6; ++i) {
+            const glm::ivec3 position =
+                Vertices::position(mesh.vertices[index_at(i)]);
+            min = glm::min(min, position);
+            max = glm::max(max, position);
+        }
+
+        const PackedVertex first = mesh.vertices[index_at(quad)];
+        const int normal_index = Vertices::normal_index(first);
+        const int n = normal_index / 2;
+        const int u = (n + 1) % 3;
+        const int v = (n + 2) % 3;
+        for (int iv = min[v]; iv < max[v]; ++iv) {
+            for (int iu = min[u]; iu < max[u]; ++iu) {
+                glm::ivec3 corner;
+                corner[n] = min[n];
+                corner[u] = iu;
+                corner[v] = iv;
+                faces.push_back(Vertices::pack(
+                            corner, normal_index, 0,
+                            Vertices::material(first)));
+            }
+        }
+    }
+    std::sort(faces.begin(), faces.end());
+    return faces;
+}
+
+// Indexed by section, empty for the sections that were not built.
+std::vector<MeshData> build_sections(
+        ChunkVolumeRepository& repository,
+        MeshBuilder& builder,
+        const ChunkId chunk_id,
+        const Chunks::SectionSet sections)
+{
+    std::vector<MeshData> section_meshes(Chunks::section_count);
+    repository.with_neighborhood(chunk_id,
+            [&](const ChunkNeighborhood& neighborhood) {
+        builder.load(neighborhood);
+        for (size_t i = 0; i < builder.section_count(); ++i) {
+            if (sections >> i & 1) {
+                section_meshes[i] = builder.build_section(i);
+            }
+        }
+    });
+    return section_meshes;
+}
+
+std::vector<uint64_t> unit_faces(const std::vector<MeshData>& meshes)
+{
+    std::vector<uint64_t> faces;
+    for (const MeshData& mesh : meshes) {
+        append(faces, unit_faces(mesh));
+    }
+    std::sort(faces.begin(), faces.end());
+    return faces;
+}
+
+void append(std::vector<uint64_t>& to, const std::vector<uint64_t>& from)
+{
+    to.insert(to.end(), from.begin(), from.end());
+}
+
+bool same_mesh(const MeshData& lhs, const MeshData& rhs)
+{
+    return lhs.vertices == rhs.vertices
+        && lhs.short_indices == rhs.short_indices
+        && lhs.indices == rhs.indices;
+}
+
+// In every voxel, every visible face and the uniformity of every section.
+bool same_masks(const SolidMasks& lhs, const SolidMasks& rhs)
+{
+    if (lhs.size_x() != rhs.size_x()
+            || lhs.size_y() != rhs.size_y()
+            || lhs.size_z() != rhs.size_z()
+            || lhs.section_count() != rhs.section_count()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.section_count(); ++i) {
+        if (lhs.section_uniformity(i) != rhs.section_uniformity(i)) {
+            return false;
+        }
+    }
+    for (size_t z = 0; z < lhs.size_z(); ++z) {
+        for (size_t y = 0; y < lhs.size_y(); ++y) {
+            for (size_t x = 0; x < lhs.size_x(); ++x) {
+                if (lhs.solid(x, y, z) != rhs.solid(x, y, z)) {
+                    return false;
+                }
+            }
+        }
+    }
+    for (size_t z = 1; z < lhs.size_z() - 1; ++z) {
+        for (size_t y = 1; y < lhs.size_y() - 1; ++y) {
+            uint64_t lhs_faces[6];
+            uint64_t rhs_faces[6];
+            lhs.visible_faces(y, z, lhs_faces);
+            rhs.visible_faces(y, z, rhs_faces);
+            if (!std::equal(lhs_faces, lhs_faces + 6, rhs_faces)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Two triangles for every visible voxel face, no more and no fewer than
+// the original voxel by voxel builder emitted.
+void per_face_matches_baseline()
+{
+    MeshBuilder builder(MeshBuilder::Mode::per_face);
+    size_t triangles = 0;
+    for (const ChunkId chunk_id : grid_chunks()) {
+        const MeshData mesh = builder.build(padded_volume(chunk_id));
+        triangles += triangle_count(mesh);
+        check(unit_faces(mesh).size() * 2 == triangle_count(mesh));
+    }
+    check(triangles == baseline_per_face_triangles);
+}
+
+// The greedy mesh covers exactly the faces of the per-face mesh, each once
+// and with the same material, with fewer vertices.
+void greedy_covers_per_face_surface()
+{
+    MeshBuilder per_face_builder(MeshBuilder::Mode::per_face);
+    MeshBuilder greedy_builder(MeshBuilder::Mode::greedy);
+    size_t per_face_vertices = 0;
+    size_t greedy_vertices = 0;
+    for (const ChunkId chunk_id : grid_chunks()) {
+        const Volume<Voxel> volume = padded_volume(chunk_id);
+        const MeshData per_face = per_face_builder.build(volume);
+        const MeshData greedy = greedy_builder.build(volume);
+        per_face_vertices += per_face.vertices.size();
+        greedy_vertices += greedy.vertices.size();
+
+        const std::vector<uint64_t> greedy_faces = unit_faces(greedy);
+        check(greedy_faces == unit_faces(per_face));
+        check(std::adjacent_find(greedy_faces.begin(), greedy_faces.end())
+                == greedy_faces.end());
+    }
+    check(greedy_vertices < per_face_vertices);
+}
+
+// A padded volume, a heightmap and a neighborhood of stored volumes give
+// the same mesh, and building it section by section covers the same faces.
+void meshing_paths_agree(const MeshBuilder::Mode mode)
+{
+    ChunkVolumeRepository repository(
+            sine_volume_sampler(), volume_byte_budget);
+    MeshBuilder builder(mode);
+    for (const ChunkId chunk_id : grid_chunks()) {
+        const MeshData from_volume = builder.build(padded_volume(chunk_id));
+        const MeshData from_heightmap = builder.build(
+                sample_heightmap(
+                    Chunks::begin_coord(chunk_id),
+                    Chunks::end_coord(chunk_id),
+                    ChunkVolumeRepository::heightmap_border_size),
+                y_size,
+                ChunkVolumeRepository::heightmap_border_size);
+        check(same_mesh(from_heightmap, from_volume));
+
+        repository.with_neighborhood(chunk_id,
+                [&](const ChunkNeighborhood& neighborhood) {
+            check(same_mesh(builder.build(neighborhood), from_volume));
+
+            builder.load(neighborhood);
+            std::vector<uint64_t> section_faces;
+            for (size_t i = 0; i < builder.section_count(); ++i) {
+                append(section_faces, unit_faces(builder.build_section(i)));
+            }
+            std::sort(section_faces.begin(), section_faces.end());
+            check(section_faces == unit_faces(from_volume));
+        });
+    }
+}
+
+// Every field comes back as packed, whatever the others are, for every
+// position the 7 bits can hold and every brightness the 3 bits keep.
+void vertex_pack_round_trips()
+{
+    const Voxel materials[] = {
+        Voxel::empty, Voxel::solid, Voxel::dirt, Voxel::grass,
+        (Voxel) Vertices::material_mask,
+    };
+    size_t mismatches = 0;
+    size_t combination = 0;
+    const int position_end = Vertices::position_mask + 1;
+    for (int z = 0; z < position_end; ++z) {
+        for (int y = 0; y < position_end; ++y) {
+            for (int x = 0; x < position_end; ++x, ++combination) {
+                const glm::ivec3 position(x, y, z);
+                const int normal_index = combination % 6;
+                const uint8_t brightness = (uint8_t)
+                    ((combination / 6 % (Vertices::brightness_mask + 1))
+                        << Vertices::brightness_dropped_bits);
+                const Voxel material = materials[combination % 5];
+
+                const PackedVertex vertex = Vertices::pack(
+                        position, normal_index, brightness, material);
+                mismatches += Vertices::position(vertex) != position
+                    || Vertices::normal_index(vertex) != normal_index
+                    || Vertices::brightness(vertex) != brightness
+                    || Vertices::material(vertex) != material;
+            }
+        }
+    }
+    check(mismatches == 0);
+
+    // With every field at its largest, all 32 bits are used, each by one
+    // field.
+    const PackedVertex all_ones = Vertices::pack(
+            glm::ivec3((int) Vertices::position_mask),
+            5,
+            (uint8_t) (Vertices::brightness_mask
+                << Vertices::brightness_dropped_bits),
+            (Voxel) Vertices::material_mask);
+    check(Vertices::position(all_ones)
+            == glm::ivec3((int) Vertices::position_mask));
+    check(Vertices::material(all_ones) == (Voxel) Vertices::material_mask);
+    check(Vertices::material_shift + 5 == 32);
+}
+
+// Positions of the vertices the builders emit are the corners of the voxels
+// of the chunk, which the 7 bits have room for.
+void mesh_vertices_within_chunk()
+{
+    const glm::ivec3 chunk_size(
+            Chunks::x_size, Chunks::y_end - Chunks::y_begin, Chunks::z_size);
+    check((int) Vertices::position_mask >= chunk_size.x);
+    check((int) Vertices::position_mask >= chunk_size.y);
+    check((int) Vertices::position_mask >= chunk_size.z);
+
+    for (const auto mode :
+            {MeshBuilder::Mode::per_face, MeshBuilder::Mode::greedy}) {
+        MeshBuilder builder(mode);
+        const MeshData mesh = builder.build(padded_volume({0, 0}));
+        size_t outside = 0;
+        for (const PackedVertex vertex : mesh.vertices) {
+            const glm::ivec3 position = Vertices::position(vertex);
+            outside += position.x > chunk_size.x
+                || position.y > chunk_size.y
+                || position.z > chunk_size.z
+                || Vertices::normal_index(vertex) >= 6
+                || Vertices::material(vertex) == Voxel::empty;
+        }
+        check(!mesh.vertices.empty());
+        check(outside == 0);
+    }
+}
+
+// Builds a grid of chunks the way ChunkMeshRepository does, on a pool of
+// workers that share a volume repository and each mesh with a builder of
+// their own. The repository has no budget, so volumes are evicted and
+// sampled again while other workers are using their neighbors. The meshes
+// come out the same as when built one after the other on this thread.
+void worker_pool_builds_like_one_thread()
+{
+    std::vector<ChunkId> chunks;
+    for (int z = 0; z < pool_grid_size; ++z) {
+        for (int x = 0; x < pool_grid_size; ++x) {
+            chunks.push_back({x, z});
+        }
+    }
+
+    ChunkVolumeRepository repository(sine_volume_sampler(), 0);
+    std::vector<MeshBuilder> builders(
+            worker_count, MeshBuilder(MeshBuilder::Mode::greedy));
+    // Each job writes only its own element.
+    std::vector<MeshData> built(chunks.size());
+    std::atomic<size_t> bad_worker_indices(0);
+    {
+        WorkerPool workers(worker_count);
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            workers.submit([&, i](const size_t worker_index) {
+                if (worker_index >= worker_count) {
+                    ++bad_worker_indices;
+                    return;
+                }
+                repository.with_neighborhood(chunks[i],
+                        [&](const ChunkNeighborhood& neighborhood) {
+                    built[i] = builders[worker_index].build(neighborhood);
+                });
+            });
+        }
+        workers.wait_until_idle();
+        check(bad_worker_indices == 0);
+
+        // Still usable once idle.
+        std::atomic<size_t> jobs_run(0);
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            workers.submit([&jobs_run](size_t) { ++jobs_run; });
+        }
+        workers.wait_until_idle();
+        check(jobs_run == chunks.size());
+    }
+
+    MeshBuilder builder(MeshBuilder::Mode::greedy);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        mismatches += !same_mesh(
+                built[i], builder.build(padded_volume(chunks[i])));
+    }
+    check(mismatches == 0);
+    check(repository.stats().evictions > 0);
+}
+
+// Turns the camera frame after frame, drawing the visible chunks the way
+// ChunkMeshRepository does: those without a mesh get one, after making room
+// for it within the capacity. The capacity is less than what is in view, so
+// the meshes of the frame have to go over it rather than evict each other,
+// and come back within it as soon as they are out of view.
+void drawn_chunks_not_evicted()
+{
+    Camera camera(16 / 9.f);
+    camera.set_position({32.f, 80.f, 32.f});
+    VisibleChunks visible_chunks(eviction_view_radius);
+    camera.look(0, glm::radians(-20.f));
+    visible_chunks.update(camera);
+    const size_t capacity = visible_chunks.chunks().size() / 2;
+
+    RecentlyDrawn<int> meshes;
+    size_t evictions = 0;
+    size_t evicted_while_drawn = 0;
+    size_t most_meshes = 0;
+    for (int frame = 0; frame < eviction_frames; ++frame) {
+        camera.look(
+                glm::radians(frame * eviction_degrees_per_frame),
+                glm::radians(-20.f));
+        visible_chunks.update(camera);
+        for (const ChunkId chunk_id : visible_chunks.chunks()) {
+            if (meshes.draw(chunk_id)) {
+                continue;
+            }
+            evictions += meshes.make_room(capacity);
+            meshes.insert(chunk_id, int(frame));
+        }
+        for (const ChunkId chunk_id : visible_chunks.chunks()) {
+            evicted_while_drawn += !meshes.find(chunk_id);
+        }
+        most_meshes = std::max(most_meshes, meshes.size());
+        meshes.next_frame();
+    }
+    check(evictions > 0);
+    check(evicted_while_drawn == 0);
+    check(most_meshes > capacity);
+
+    // Nothing has been drawn in this frame yet, so the first new mesh
+    // brings them all back within the capacity at once.
+    check(meshes.size() > capacity + 1);
+    const ChunkId new_chunk = {1000, 1000};
+    meshes.make_room(capacity);
+    meshes.insert(new_chunk, int(eviction_frames));
+    check(meshes.size() == capacity);
+
+    // Only the mesh drawn during this frame stays.
+    check(meshes.shrink_to(0) == capacity - 1);
+    check(meshes.size() == 1 && meshes.find(new_chunk));
+    meshes.next_frame();
+    check(meshes.shrink_to(0) == 1);
+    check(meshes.size() == 0);
+}
+
+// Every kind of volume the masks load from gives the same masks for the
+// same voxels: terrain with caves, so that not every column is a single run,
+// as a padded volume, palette compressed whole or by section, and as the
+// neighborhood of stored volumes; and terrain without, from its heightmap.
+void solid_masks_agree_across_volume_types()
+{
+    NoiseTerrain::Settings cave_settings;
+    cave_settings.caves = true;
+    const NoiseTerrain cave_terrain(cave_settings);
+    const NoiseTerrain terrain(NoiseTerrain::Settings{});
+    const ChunkId chunk_id = {0, 0};
+    const glm::ivec3 begin = Chunks::begin_coord(chunk_id);
+    const glm::ivec3 end = Chunks::end_coord(chunk_id);
+
+    const Volume<Voxel> cave_volume = cave_terrain.volume(begin, end, 1);
+    SolidMasks from_volume;
+    from_volume.load(cave_volume);
+
+    SolidMasks from_palette;
+    from_palette.load(PaletteVolume<Voxel>(cave_volume));
+    check(same_masks(from_palette, from_volume));
+
+    SolidMasks from_sections;
+    from_sections.load(
+            SectionedVolume(cave_volume, 1, Chunks::section_height));
+    check(same_masks(from_sections, from_volume));
+
+    const auto neighborhood = [&chunk_id](const NoiseTerrain& t) {
+        std::array<ChunkNeighborhood::VolumePtr, 9> neighbors;
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                const ChunkId neighbor = {chunk_id.x + dx, chunk_id.z + dz};
+                neighbors[(dz + 1) * 3 + dx + 1] =
+                    std::make_shared<const SectionedVolume>(
+                            t.volume(
+                                Chunks::begin_coord(neighbor),
+                                Chunks::end_coord(neighbor),
+                                0),
+                            0,
+                            Chunks::section_height);
+            }
+        }
+        return ChunkNeighborhood(neighbors);
+    };
+    SolidMasks from_neighborhood;
+    from_neighborhood.load(neighborhood(cave_terrain));
+    check(same_masks(from_neighborhood, from_volume));
+
+    // Without caves, the lowest and highest sections are uniform.
+    SolidMasks from_terrain_volume;
+    from_terrain_volume.load(terrain.volume(begin, end, 1));
+    check(from_terrain_volume.section_uniformity(0)
+            == SolidMasks::Uniformity::solid);
+    check(from_terrain_volume.section_uniformity(
+                from_terrain_volume.section_count() - 1)
+            == SolidMasks::Uniformity::empty);
+    SolidMasks from_terrain_neighborhood;
+    from_terrain_neighborhood.load(neighborhood(terrain));
+    check(same_masks(from_terrain_neighborhood, from_terrain_volume));
+    SolidMasks from_heightmap;
+    from_heightmap.load(terrain.heightmap(begin, end, 1), y_size, 1);
+    check(same_masks(from_heightmap, from_terrain_volume));
+}
+
+// The dense volume the sampler returns is the only one a chunk allocates on
+// its way into the repository. Once the volumes are resident, getting the
+// neighborhood of a chunk allocates nothing, and meshing it copies none of
+// the volumes, with a builder that has built a chunk before.
+void chunks_not_copied()
+{
+    ChunkVolumeRepository repository(
+            sine_volume_sampler(), volume_byte_budget);
+    const std::vector<ChunkId> chunks = grid_chunks();
+
+    const size_t volume_sized_before_sampling = volume_sized_allocation_count;
+    for (const ChunkId chunk_id : chunks) {
+        repository.with(chunk_id, [](const SectionedVolume&) {});
+    }
+    check(volume_sized_allocation_count - volume_sized_before_sampling
+            == chunks.size());
+
+    // Those whose neighbors are all in the grid.
+    std::vector<ChunkId> inner_chunks;
+    for (const ChunkId chunk_id : chunks) {
+        if (std::abs(chunk_id.x) < grid_radius
+                && std::abs(chunk_id.z) < grid_radius) {
+            inner_chunks.push_back(chunk_id);
+        }
+    }
+
+    const size_t before_neighborhoods = allocation_count;
+    for (const ChunkId chunk_id : inner_chunks) {
+        repository.with_neighborhood(chunk_id,
+                [](const ChunkNeighborhood&) {});
+    }
+    check(allocation_count == before_neighborhoods);
+
+    for (const auto mode :
+            {MeshBuilder::Mode::per_face, MeshBuilder::Mode::greedy}) {
+        MeshBuilder builder(mode);
+        const auto build = [&builder](const ChunkNeighborhood& neighborhood) {
+            builder.build(neighborhood);
+        };
+        // Which allocates the scratch space the builder keeps.
+        repository.with_neighborhood(inner_chunks.front(), build);
+
+        const size_t volume_sized_before_meshing =
+            volume_sized_allocation_count;
+        for (const ChunkId chunk_id : inner_chunks) {
+            repository.with_neighborhood(chunk_id, build);
+        }
+        check(volume_sized_allocation_count == volume_sized_before_meshing);
+    }
+}
+
+// Digs a shaft down the last column of x of a chunk and rebuilds only the
+// sections the edits touch, as ChunkMeshRepository does. The chunk next to
+// the shaft along x gets the faces of its first column that now face into
+// the shaft and nothing else; both chunks end up meshed as if they had been
+// sampled with the shaft in place.
+void edits_remesh_chunk_and_neighbors()
+{
+    ChunkVolumeRepository repository(
+            sine_volume_sampler(), volume_byte_budget);
+    MeshBuilder builder(MeshBuilder::Mode::greedy);
+    const ChunkId edited = {0, 0};
+    const ChunkId neighbor = {1, 0};
+    std::unordered_map<ChunkId, std::vector<MeshData>> meshes;
+    for (const ChunkId chunk_id : {edited, neighbor}) {
+        meshes[chunk_id] = build_sections(
+                repository, builder, chunk_id, Chunks::all_sections);
+    }
+    const std::vector<uint64_t> neighbor_faces_before =
+        unit_faces(meshes[neighbor]);
+    const std::vector<uint64_t> edited_faces_before =
+        unit_faces(meshes[edited]);
+
+    const int shaft_x = Chunks::x_size - 1;
+    const int shaft_z = Chunks::z_size / 2;
+    const int shaft_begin_y = 1;
+    const int shaft_end_y = y_size / 2;
+    std::unordered_map<ChunkId, Chunks::SectionSet> dirty_sections;
+    for (int y = shaft_begin_y; y < shaft_end_y; ++y) {
+        for (const ChunkId chunk_id : repository.set_voxel(
+                    {shaft_x, y, shaft_z}, Voxel::empty)) {
+            dirty_sections[chunk_id] |= Chunks::sections_around(y);
+        }
+    }
+    check(dirty_sections.size() == 2);
+    check(dirty_sections.count(edited) == 1);
+    check(dirty_sections.count(neighbor) == 1);
+    check(dirty_sections[edited] != Chunks::all_sections);
+
+    for (const auto& dirty : dirty_sections) {
+        const std::vector<MeshData> rebuilt = build_sections(
+                repository, builder, dirty.first, dirty.second);
+        for (size_t i = 0; i < rebuilt.size(); ++i) {
+            if (dirty.second >> i & 1) {
+                meshes[dirty.first][i] = rebuilt[i];
+            }
+        }
+    }
+
+    for (const ChunkId chunk_id : {edited, neighbor}) {
+        Volume<Voxel> expected = padded_volume(chunk_id);
+        const glm::ivec3 begin = Chunks::begin_coord(chunk_id);
+        for (int y = shaft_begin_y; y < shaft_end_y; ++y) {
+            const glm::ivec3 padded_pos =
+                glm::ivec3(shaft_x, y, shaft_z) - begin + glm::ivec3(1);
+            expected.at(padded_pos) = Voxel::empty;
+        }
+        check(unit_faces(meshes[chunk_id])
+                == unit_faces(builder.build(expected)));
+    }
+    check(unit_faces(meshes[edited]) != edited_faces_before);
+
+    const std::vector<uint64_t> neighbor_faces = unit_faces(meshes[neighbor]);
+    std::vector<uint64_t> added;
+    std::set_difference(
+            neighbor_faces.begin(), neighbor_faces.end(),
+            neighbor_faces_before.begin(), neighbor_faces_before.end(),
+            std::back_inserter(added));
+    check(!added.empty());
+    check(neighbor_faces.size()
+            == neighbor_faces_before.size() + added.size());
+    for (const PackedVertex face : added) {
+        check(Vertices::normal_index(face) == 0);
+        check(Vertices::position(face).x == 0);
+        check(Vertices::position(face).z == shaft_z);
+    }
+}
+
+// With no budget at all, every volume goes as soon as nothing uses it,
+// unless it has been edited.
+void volumes_in_use_or_edited_not_evicted()
+{
+    ChunkVolumeRepository repository(sine_volume_sampler(), 0);
+    const ChunkId used = {0, 0};
+    const ChunkId edited = {1, 0};
+
+    repository.with(used, [&](const SectionedVolume&) {
+        repository.with(used, [](const SectionedVolume&) {});
+        repository.with_neighborhood(used, [](const ChunkNeighborhood&) {});
+        check(repository.stats().bytes_resident > 0);
+    });
+    ChunkVolumeRepository::Stats stats = repository.stats();
+    // Sampled once for with() and once for each neighbor.
+    check(stats.misses == 9);
+    check(stats.hits == 2);
+    check(stats.evictions == 9);
+    check(stats.bytes_resident == 0);
+
+    repository.set_voxel(Chunks::begin_coord(edited), Voxel::empty);
+    repository.with(edited, [](const SectionedVolume& volume) {
+        check(volume.at(0, 0, 0) == Voxel::empty);
+    });
+    stats = repository.stats();
+    check(stats.misses == 10);
+    check(stats.evictions == 9);
+    check(stats.bytes_resident > 0);
+    check(repository.neighborhood_edited(used));
+}
+
+// A row of fractal noise is the same, bit for bit, as its samples one at a
+// time, on both sides of zero and across lattice cells.
+void noise_rows_match_samples()
+{
+    const Noise noise(1234);
+    const int octaves = 5;
+    std::vector<float> xs;
+    for (int x = -150; x < 150; ++x) {
+        xs.push_back(x * 0.0173f);
+    }
+    std::vector<float> row(xs.size());
+    size_t mismatches = 0;
+    for (int z = -20; z < 20; ++z) {
+        noise.fractal_row(xs.data(), xs.size(), z * 0.31f, octaves,
+                row.data());
+        for (size_t i = 0; i < xs.size(); ++i) {
+            mismatches +=
+                row[i] != noise.fractal(xs[i], z * 0.31f, octaves);
+        }
+    }
+    check(mismatches == 0);
+}
+
+// Run-length columns hold the same voxels as the dense volume they come
+// from, and mesh the same in both modes: terrain with caves, so that
+// columns have several runs, and terrain built straight from a heightmap.
+void column_volumes_mesh_like_dense()
+{
+    NoiseTerrain::Settings cave_settings;
+    cave_settings.caves = true;
+    const NoiseTerrain cave_terrain(cave_settings);
+    const NoiseTerrain terrain(NoiseTerrain::Settings{});
+    MeshBuilder per_face_builder(MeshBuilder::Mode::per_face);
+    MeshBuilder greedy_builder(MeshBuilder::Mode::greedy);
+    size_t mismatched_voxels = 0;
+    for (const ChunkId chunk_id : grid_chunks()) {
+        const glm::ivec3 begin = Chunks::begin_coord(chunk_id);
+        const glm::ivec3 end = Chunks::end_coord(chunk_id);
+        const Volume<Voxel> cave_volume = cave_terrain.volume(begin, end, 1);
+        const Heightmap heightmap = terrain.heightmap(begin, end, 1);
+        const Volume<Voxel> terrain_volume =
+            volume_from_heightmap(heightmap, y_size, 1);
+
+        const std::pair<const Volume<Voxel>*, ColumnVolume> pairs[] = {
+            { &cave_volume, ColumnVolume(cave_volume) },
+            { &terrain_volume,
+                column_volume_from_heightmap(heightmap, y_size, 1) },
+        };
+        for (const auto& pair : pairs) {
+            const Volume<Voxel>& dense = *pair.first;
+            const ColumnVolume& columns = pair.second;
+            for (size_t z = 0; z < dense.size_z(); ++z) {
+                for (size_t y = 0; y < dense.size_y(); ++y) {
+                    for (size_t x = 0; x < dense.size_x(); ++x) {
+                        mismatched_voxels +=
+                            columns.at(x, y, z) != dense.at(x, y, z);
+                    }
+                }
+            }
+            check(columns.byte_size() < dense.byte_size());
+            check(same_mesh(per_face_builder.build(columns),
+                        per_face_builder.build(dense)));
+            check(same_mesh(greedy_builder.build(columns),
+                        greedy_builder.build(dense)));
+        }
+    }
+    check(mismatched_voxels == 0);
+}
+
+// One bit per voxel keeps whether each voxel of terrain with caves is
+// solid, read one voxel at a time or as whole rows from any start, and
+// gives the same masks and faces as the dense volume.
+void bit_volumes_match_dense()
+{
+    NoiseTerrain::Settings cave_settings;
+    cave_settings.caves = true;
+    const NoiseTerrain cave_terrain(cave_settings);
+    const ChunkId chunk_id = {0, 0};
+    const Volume<Voxel> dense = cave_terrain.volume(
+            Chunks::begin_coord(chunk_id), Chunks::end_coord(chunk_id), 1);
+    const BitVolume bits(dense);
+    // Padded rows of 66 voxels take two words.
+    check(bits.byte_size() * 4 < dense.byte_size());
+
+    size_t mismatched_voxels = 0;
+    size_t mismatched_rows = 0;
+    for (size_t z = 0; z < dense.size_z(); ++z) {
+        for (size_t y = 0; y < dense.size_y(); ++y) {
+            for (size_t x = 0; x < dense.size_x(); ++x) {
+                mismatched_voxels += (bits.at(x, y, z) != Voxel::empty)
+                    != (dense.at(x, y, z) != Voxel::empty);
+
+                uint64_t row = 0;
+                for (size_t i = 0; i < 64 && x + i < dense.size_x(); ++i) {
+                    if (dense.at(x + i, y, z) != Voxel::empty) {
+                        row |= uint64_t(1) << i;
+                    }
+                }
+                mismatched_rows += bits.row_bits(x, y, z) != row;
+            }
+        }
+    }
+    check(mismatched_voxels == 0);
+    check(mismatched_rows == 0);
+
+    SolidMasks from_bits;
+    from_bits.load(bits);
+    SolidMasks from_dense;
+    from_dense.load(dense);
+    check(same_masks(from_bits, from_dense));
+}
+
+// Seen from the middle of chunk (0, 0), looking along +x: of two equally
+// near chunks the one in front goes first, nearer chunks go before farther
+// ones, no more start than a frame or the builds in flight allow, and
+// whatever was not taken is forgotten.
+void scheduler_orders_and_limits_builds()
+{
+    BuildScheduler scheduler(4, 2);
+    scheduler.set_viewpoint(
+            glm::vec3(Chunks::x_size / 2, 40, Chunks::z_size / 2),
+            glm::vec3(1, 0, 0));
+    const ChunkId behind = {-1, 0};
+    const ChunkId in_front = {1, 0};
+    const ChunkId far_in_front = {2, 0};
+    const ChunkId farthest_in_front = {3, 0};
+    check(scheduler.priority(in_front) < scheduler.priority(behind));
+
+    scheduler.request(behind);
+    scheduler.request(in_front);
+    std::vector<ChunkId> taken = scheduler.take(0);
+    check(taken.size() == 2 && taken[0] == in_front && taken[1] == behind);
+
+    scheduler.request(farthest_in_front);
+    scheduler.request(far_in_front);
+    scheduler.request(in_front);
+    taken = scheduler.take(0);
+    check(taken.size() == 2
+            && taken[0] == in_front && taken[1] == far_in_front);
+    check(scheduler.take(0).empty());
+
+    scheduler.request(in_front);
+    scheduler.request(far_in_front);
+    check(scheduler.take(4).empty());
+    check(scheduler.take(0).empty());
+
+    scheduler.request(in_front);
+    scheduler.request(far_in_front);
+    taken = scheduler.take(3);
+    check(taken.size() == 1 && taken[0] == in_front);
+    check(scheduler.take(0).empty());
+}
+
+// From the middle of chunk (0, 0), looking along -z: boxes in front of the
+// camera intersect its frustum, those behind it or past the far plane do
+// not. The visible chunks are those in front, nearest first, and they are
+// only recomputed once the camera moves.
+void frustum_culls_and_orders_chunks()
+{
+    Camera camera(1.f);
+    const glm::vec3 position(Chunks::x_size / 2, 40, Chunks::z_size / 2);
+    camera.set_position(position);
+    const Frustum frustum(camera.calc_world_to_clip());
+    const glm::vec3 extent(1.f);
+    const glm::vec3 in_front = position + glm::vec3(0, 0, -50);
+    const glm::vec3 behind = position + glm::vec3(0, 0, 50);
+    const glm::vec3 past_far_plane = position
+        + glm::vec3(0, 0, -camera::far_clipping_plane_dist - 10);
+    check(frustum.intersects(in_front - extent, in_front + extent));
+    check(!frustum.intersects(behind - extent, behind + extent));
+    check(!frustum.intersects(
+                past_far_plane - extent, past_far_plane + extent));
+
+    VisibleChunks visible_chunks(8);
+    check(visible_chunks.update(camera));
+    const std::vector<ChunkId>& chunks = visible_chunks.chunks();
+    check(!chunks.empty());
+    check(visible_chunks.culled_count() > 0);
+    const auto has = [&chunks](ChunkId chunk_id) {
+        return std::find(chunks.begin(), chunks.end(), chunk_id)
+            != chunks.end();
+    };
+    check(has({0, 0}));
+    check(has({0, -4}));
+    check(!has({0, 4}));
+
+    float last_distance = 0;
+    bool sorted = true;
+    for (const ChunkId chunk_id : chunks) {
+        const glm::vec3 center = glm::vec3(
+                Chunks::begin_coord(chunk_id) + Chunks::end_coord(chunk_id))
+            / 2.f;
+        const float distance_x = center.x - position.x;
+        const float distance_z = center.z - position.z;
+        const float distance =
+            distance_x * distance_x + distance_z * distance_z;
+        sorted = sorted && distance >= last_distance;
+        last_distance = distance;
+    }
+    check(sorted);
+
+    check(!visible_chunks.update(camera));
+    camera.move(1.f);
+    check(visible_chunks.update(camera));
+}
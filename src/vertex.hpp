@@ -0,0 +1,87 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include "voxel.hpp"
+
+#include <cassert>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// A chunk mesh vertex packed into 32 bits, from the least significant bit:
+// 7 bits each for the chunk-local x, y and z position, 3 bits for the index
+// of the normal, 3 bits for the brightness, whose lower 5 bits are always
+// zero, and 5 bits for the material. Decoded by res/shader.vert.
+typedef uint32_t PackedVertex;
+
+namespace Vertices
+{
+
+constexpr int position_bits = 7;
+constexpr uint32_t position_mask = (1 << position_bits) - 1;
+constexpr int normal_shift = 3 * position_bits;
+constexpr uint32_t normal_mask = 0x7;
+constexpr int brightness_shift = normal_shift + 3;
+constexpr uint32_t brightness_mask = 0x7;
+constexpr int brightness_dropped_bits = 5;
+constexpr int material_shift = brightness_shift + 3;
+constexpr uint32_t material_mask = 0x1F;
+
+// Indexed by the normal index, in the same order as in the shader.
+const glm::ivec3 normals[] = {
+    glm::ivec3(-1, 0, 0),
+    glm::ivec3(1, 0, 0),
+    glm::ivec3(0, -1, 0),
+    glm::ivec3(0, 1, 0),
+    glm::ivec3(0, 0, -1),
+    glm::ivec3(0, 0, 1),
+};
+
+PackedVertex pack(
+        const glm::ivec3 position,
+        const int normal_index,
+        const uint8_t brightness,
+        const Voxel material)
+{
+    assert(position.x >= 0 && (uint32_t) position.x <= position_mask);
+    assert(position.y >= 0 && (uint32_t) position.y <= position_mask);
+    assert(position.z >= 0 && (uint32_t) position.z <= position_mask);
+    assert(normal_index >= 0 && normal_index < 6);
+    assert((brightness & ((1 << brightness_dropped_bits) - 1)) == 0);
+    assert((uint32_t) material <= material_mask);
+
+    return (PackedVertex) position.x
+        | (PackedVertex) position.y << position_bits
+        | (PackedVertex) position.z << 2 * position_bits
+        | (PackedVertex) normal_index << normal_shift
+        | (PackedVertex) (brightness >> brightness_dropped_bits)
+            << brightness_shift
+        | (PackedVertex) material << material_shift;
+}
+
+glm::ivec3 position(const PackedVertex vertex)
+{
+    return glm::ivec3(
+            vertex & position_mask,
+            vertex >> position_bits & position_mask,
+            vertex >> 2 * position_bits & position_mask);
+}
+
+int normal_index(const PackedVertex vertex)
+{
+    return vertex >> normal_shift & normal_mask;
+}
+
+uint8_t brightness(const PackedVertex vertex)
+{
+    return (vertex >> brightness_shift & brightness_mask)
+        << brightness_dropped_bits;
+}
+
+Voxel material(const PackedVertex vertex)
+{
+    return (Voxel) (vertex >> material_shift & material_mask);
+}
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Maps packed vertices to their index in a mesh, so that a vertex shared by
+// several faces is stored only once. Open addressing with linear probing;
+// the normal index never has all of its bits set, so neither does a packed
+// vertex, and that value marks the empty slots.
+class VertexIndexTable
+{
+public:
+    void clear();
+
+    // Returns the index of the vertex and whether it was inserted with
+    // next_index just now.
+    std::pair<uint32_t, bool> insert(PackedVertex, uint32_t next_index);
+private:
+    static constexpr PackedVertex empty_slot = 0xFFFFFFFF;
+    static constexpr int initial_capacity_bits = 12;
+
+    std::vector<PackedVertex> keys;
+    std::vector<uint32_t> indices;
+    int capacity_bits = 0;
+    size_t size = 0;
+
+    size_t slot_of(PackedVertex) const;
+    void grow();
+};
+
+constexpr PackedVertex VertexIndexTable::empty_slot;
+
+void VertexIndexTable::clear()
+{
+    if (capacity_bits == 0) {
+        capacity_bits = initial_capacity_bits;
+        keys.resize(size_t(1) << capacity_bits);
+        indices.resize(size_t(1) << capacity_bits);
+    }
+    std::fill(keys.begin(), keys.end(), empty_slot);
+    size = 0;
+}
+
+std::pair<uint32_t, bool> VertexIndexTable::insert(
+        const PackedVertex vertex, const uint32_t next_index)
+{
+    assert(vertex != empty_slot);
+
+    // Keeping the load factor at most a half keeps the probes short.
+    if (2 * (size + 1) > keys.size()) {
+        grow();
+    }
+
+    const size_t mask = keys.size() - 1;
+    for (size_t slot = slot_of(vertex); ; slot = (slot + 1) & mask) {
+        if (keys[slot] == vertex) {
+            return { indices[slot], false };
+        } else if (keys[slot] == empty_slot) {
+            keys[slot] = vertex;
+            indices[slot] = next_index;
+            ++size;
+            return { next_index, true };
+        }
+    }
+}
+
+size_t VertexIndexTable::slot_of(const PackedVertex vertex) const
+{
+    // Fibonacci hashing, taking the top bits of the product.
+    return uint32_t(vertex * 0x9E3779B1u) >> (32 - capacity_bits);
+}
+
+void VertexIndexTable::grow()
+{
+    std::vector<PackedVertex> old_keys(keys.size() * 2, empty_slot);
+    std::vector<uint32_t> old_indices(indices.size() * 2);
+    old_keys.swap(keys);
+    old_indices.swap(indices);
+    ++capacity_bits;
+    size = 0;
+
+    for (size_t i = 0; i < old_keys.size(); ++i) {
+        if (old_keys[i] != empty_slot) {
+            insert(old_keys[i], old_indices[i]);
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include "camera.hpp"
+#include "chunk.hpp"
+#include "frustum.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// The chunks around the camera that it can see: those in the circle of
+// view_radius chunks around its own whose bounds intersect its view
+// frustum. They are ordered front to back, nearest first, so that drawing
+// them in order lets the depth test reject as much as it can early.
+//
+// Only recomputed when the camera has moved, turned or zoomed, or the view
+// radius has changed.
+class VisibleChunks
+{
+public:
+    explicit VisibleChunks(int radius) : view_radius(radius) {}
+
+    int get_view_radius() const { return view_radius; }
+    void set_view_radius(int);
+    // Of chunks in a circle of the radius.
+    static size_t count_in_range(int radius);
+
+    // Returns whether the camera had changed since the last call.
+    bool update(const Camera&);
+
+    const std::vector<ChunkId>& chunks() const { return visible; }
+    // Of the last update.
+    const glm::mat4& world_to_clip() const { return last_world_to_clip; }
+    // Chunks in the circle that are outside of the frustum.
+    size_t culled_count() const { return in_range - visible.size(); }
+    size_t in_range_count() const { return in_range; }
+private:
+    int view_radius;
+
+    bool updated = false;
+    glm::mat4 last_world_to_clip;
+    std::vector<ChunkId> visible;
+    size_t in_range = 0;
+    // Visible chunks with their squared distance from the camera, kept
+    // between updates to reuse its memory.
+    std::vector<std::pair<float, ChunkId>> by_distance;
+};
+
+void VisibleChunks::set_view_radius(const int new_view_radius)
+{
+    assert(new_view_radius >= 0);
+    view_radius = new_view_radius;
+    updated = false;
+}
+
+size_t VisibleChunks::count_in_range(const int radius)
+{
+    size_t count = 0;
+    for (int dz = -radius; dz <= radius; ++dz) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+            count += dx * dx + dz * dz <= radius * radius;
+        }
+    }
+    return count;
+}
+
+bool VisibleChunks::update(const Camera& camera)
+{
+    const glm::mat4 world_to_clip = camera.calc_world_to_clip();
+    if (updated && world_to_clip == last_world_to_clip) {
+        return false;
+    }
+    updated = true;
+    last_world_to_clip = world_to_clip;
+
+    const Frustum frustum(world_to_clip);
+    const glm::vec3 position = camera.get_position();
+    const ChunkId camera_chunk = Chunks::chunk_at(position);
+    by_distance.clear();
+    in_range = 0;
+    for (int dz = -view_radius; dz <= view_radius; ++dz) {
+        for (int dx = -view_radius; dx <= view_radius; ++dx) {
+            if (dx * dx + dz * dz > view_radius * view_radius) {
+                continue;
+            }
+            const ChunkId chunk_id = {camera_chunk.x + dx, camera_chunk.z + dz};
+            const glm::vec3 min(Chunks::begin_coord(chunk_id));
+            const glm::vec3 max(Chunks::end_coord(chunk_id));
+            ++in_range;
+            if (!frustum.intersects(min, max)) {
+                continue;
+            }
+
+            // To the center of the chunk, along x and z only, since every
+            // chunk spans the same heights.
+            const float distance_x = (min.x + max.x) / 2 - position.x;
+            const float distance_z = (min.z + max.z) / 2 - position.z;
+            by_distance.emplace_back(
+                    distance_x * distance_x + distance_z * distance_z,
+                    chunk_id);
+        }
+    }
+
+    // Equally distant chunks are ordered by their coordinates, so that the
+    // order does not change from one update to the next.
+    std::sort(by_distance.begin(), by_distance.end(),
+            [](const std::pair<float, ChunkId>& lhs,
+                const std::pair<float, ChunkId>& rhs) {
+                if (lhs.first != rhs.first) {
+                    return lhs.first < rhs.first;
+                }
+                return lhs.second.z != rhs.second.z
+                    ? lhs.second.z < rhs.second.z
+                    : lhs.second.x < rhs.second.x;
+            });
+    visible.clear();
+    for (const auto& chunk : by_distance) {
+        visible.push_back(chunk.second);
+    }
+    return true;
+}
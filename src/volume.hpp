@@ -21,6 +21,7 @@ public:
     size_t size_x() const { return s_x; }
     size_t size_y() const { return s_y; }
     size_t size_z() const { return s_z; }
+    size_t byte_size() const { return data.size() * sizeof(T); }
 
     T& at(size_t x, size_t y, size_t z);
     T& at(glm::ivec3 v) { return at(v.x, v.y, v.z); }
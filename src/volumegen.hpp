@@ -2,12 +2,34 @@
 
 #define GLM_FORCE_RADIANS
 
+#include "column_volume.hpp"
 #include "heightmap.hpp"
 #include "volume.hpp"
 #include "voxel.hpp"
 
+#include <cmath>
+#include <vector>
+
 #include <glm/glm.hpp>
 
+// Terrain columns are topped by grass over this many voxels of dirt.
+constexpr size_t dirt_depth = 3;
+
+// The voxel at height y of a terrain column whose topmost solid voxel is at
+// height top.
+Voxel terrain_voxel(const size_t top, const size_t y)
+{
+    if (y > top) {
+        return Voxel::empty;
+    } else if (y == top) {
+        return Voxel::grass;
+    } else if (y + dirt_depth >= top) {
+        return Voxel::dirt;
+    } else {
+        return Voxel::solid;
+    }
+}
+
 Heightmap sample_heightmap(glm::ivec3 begin_coord, glm::ivec3 end_coord,
         int border_size)
 {
@@ -20,22 +42,33 @@ Heightmap sample_heightmap(glm::ivec3 begin_coord, glm::ivec3 end_coord,
     const size_t z_size = end_coord.z - begin_coord.z;
 
     Heightmap heightmap(x_size + 2 * border_size, z_size + 2 * border_size);
-    for (size_t vz = 0; vz < heightmap.z_size(); ++vz) {
-        for (size_t vx = 0; vx < heightmap.x_size(); ++vx) {
-            const double x = (begin_coord.x + (int)vx - border_size) / (double) x_size;
-            const double z = (begin_coord.z + (int)vz - border_size) / (double) z_size;
 
-            const double y = 0.5 * (sin(x) * cos(z) + 1);
-            const uint8_t height = y_size * y;
-            heightmap.at(vx, vz) = height;
+    // sin(x) * cos(z) is separable, so each factor is only evaluated once
+    // per column or row of the heightmap. That leaves a multiply-add per
+    // sample, which the inner loop does over whole rows.
+    std::vector<double> sin_x(heightmap.x_size());
+    for (size_t vx = 0; vx < heightmap.x_size(); ++vx) {
+        const double x = (begin_coord.x + (int)vx - border_size) / (double) x_size;
+        sin_x[vx] = sin(x);
+    }
+
+    for (size_t vz = 0; vz < heightmap.z_size(); ++vz) {
+        const double z = (begin_coord.z + (int)vz - border_size) / (double) z_size;
+        const double cos_z = cos(z);
 
-            assert(height >= begin_coord.y);
-            assert(height < end_coord.y);
+        uint8_t* const row = &heightmap.at(0, vz);
+        for (size_t vx = 0; vx < heightmap.x_size(); ++vx) {
+            const double y = 0.5 * (sin_x[vx] * cos_z + 1);
+            row[vx] = y_size * y;
         }
     }
+
+    assert(heightmap.min_height() >= begin_coord.y);
+    assert(heightmap.max_height() < end_coord.y);
     return heightmap;
 }
 
+// Columns are solid up to their height, topped by grass over dirt.
 Volume<Voxel> volume_from_heightmap(const Heightmap &heightmap, size_t y_size,
         size_t border_size)
 {
@@ -46,11 +79,41 @@ Volume<Voxel> volume_from_heightmap(const Heightmap &heightmap, size_t y_size,
             Voxel::empty);
     for (size_t z = 0; z < z_size; ++z) {
         for (size_t x = 0; x < x_size; ++x) {
-            const uint8_t height = heightmap.at(x, z);
-            for (uint8_t y = 0; y <= border_size + height; ++y) {
-                volume.at(x, y, z) = Voxel::solid;
+            const size_t top = border_size + heightmap.at(x, z);
+            for (size_t y = 0; y <= top; ++y) {
+                volume.at(x, y, z) = terrain_voxel(top, y);
+            }
+        }
+    }
+    return volume;
+}
+
+// The same voxels as volume_from_heightmap, without going through a dense
+// volume.
+ColumnVolume column_volume_from_heightmap(const Heightmap &heightmap,
+        size_t y_size, size_t border_size)
+{
+    const size_t x_size = heightmap.x_size();
+    const size_t z_size = heightmap.z_size();
+    const size_t volume_y_size = y_size + 2 * border_size;
+
+    ColumnVolume volume(x_size, volume_y_size, z_size);
+    for (size_t z = 0; z < z_size; ++z) {
+        for (size_t x = 0; x < x_size; ++x) {
+            const size_t top = border_size + heightmap.at(x, z);
+            const size_t dirt_begin = top > dirt_depth ? top - dirt_depth : 0;
+            if (dirt_begin > 0) {
+                volume.append_run(Voxel::solid, dirt_begin);
+            }
+            if (top > dirt_begin) {
+                volume.append_run(Voxel::dirt, top - dirt_begin);
+            }
+            volume.append_run(Voxel::grass, 1);
+            if (top + 1 < volume_y_size) {
+                volume.append_run(Voxel::empty, volume_y_size - top - 1);
             }
         }
     }
+    assert(volume.complete());
     return volume;
 }
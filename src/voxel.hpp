@@ -1,7 +1,14 @@
 #pragma once
 
+#include <cstdint>
+
+// Every value other than empty is an opaque material. The values are packed
+// into mesh vertices, see vertex.hpp, and index the material colors in
+// res/shader.vert.
 enum class Voxel : uint8_t
 {
     empty,
     solid,
+    dirt,
+    grass,
 };
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs jobs on a fixed set of background threads, in the order they were
+// submitted. Each job is told the index of the worker running it, so that
+// callers can keep per-worker scratch state without locking.
+class WorkerPool
+{
+public:
+    typedef std::function<void(size_t worker_index)> Job;
+
+    explicit WorkerPool(size_t thread_count);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const { return threads.size(); }
+
+    void submit(Job);
+    void wait_until_idle();
+
+    static size_t default_thread_count();
+private:
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable job_submitted;
+    std::condition_variable job_finished;
+    std::deque<Job> jobs;
+    size_t running_job_count = 0;
+    bool stopping = false;
+
+    void run(size_t worker_index);
+};
+
+WorkerPool::WorkerPool(const size_t thread_count)
+{
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back([this, i] { this->run(i); });
+    }
+}
+
+// Jobs that have not started yet are dropped.
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    job_submitted.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::submit(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    job_submitted.notify_one();
+}
+
+void WorkerPool::wait_until_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    job_finished.wait(lock, [this] {
+        return jobs.empty() && running_job_count == 0;
+    });
+}
+
+// Leaves a core for the render loop.
+size_t WorkerPool::default_thread_count()
+{
+    const size_t hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 1;
+}
+
+void WorkerPool::run(const size_t worker_index)
+{
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_submitted.wait(lock, [this] {
+                return stopping || !jobs.empty();
+            });
+            if (stopping) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            ++running_job_count;
+        }
+
+        job(worker_index);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --running_job_count;
+        }
+        job_finished.notify_all();
+    }
+}